@@ -0,0 +1,108 @@
+#include <benchmark.h>
+#include <bvh.h>
+#include <frustum_culling.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+#include <random>
+#include <thread>
+#include <string>
+#include <algorithm>
+#include <cmath>
+
+//Builds a BVH over 100k and 10M cubes scattered with the same density, then culls them for a
+//camera which turns a full circle and casts random rays. The frustum culling is compared with
+//the flat SIMD culling of FrustumCuller, which tests every instance. It doesn't need an OpenGL
+//context. 10M instances take about 1.5 GB.
+
+const std::size_t instanceNumbers[] = {100000, 10000000};
+const int frameNumber = 30;
+const int rayNumber = 100000;
+const float farPlane = 200.0f;
+
+void run(std::size_t instanceNumber)
+{
+    //About one cube per 64 cubic units
+    float worldSize = 4.0f * std::cbrt(static_cast<float>(instanceNumber));
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> position(-worldSize * 0.5f, worldSize * 0.5f);
+    std::uniform_real_distribution<float> halfSize(0.25f, 1.0f);
+    std::vector<Aabb> bounds(instanceNumber);
+    BoundingSpheres spheres;
+    spheres.reserve(instanceNumber);
+    for (auto& box : bounds)
+    {
+        glm::vec3 center(position(random), position(random), position(random));
+        float size = halfSize(random);
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            box.min[axis] = center[axis] - size;
+            box.max[axis] = center[axis] + size;
+        }
+        spheres.add(center, size * 1.7321f);
+    }
+    std::cout << instanceNumber << " instances" << std::endl;
+
+    unsigned threadNumber = std::max(1u, std::thread::hardware_concurrency());
+    Bvh bvh;
+    Timer timer;
+    bvh.build(bounds.data(), bounds.size(), 1);
+    printResult("  build, 1 thread", timer.elapsedMilliseconds(), "ms");
+    if (threadNumber > 1)
+    {
+        timer.restart();
+        bvh.build(bounds.data(), bounds.size(), threadNumber);
+        std::string name = "  build, " + std::to_string(threadNumber) + " threads";
+        printResult(name.c_str(), timer.elapsedMilliseconds(), "ms");
+    }
+    printResult("  nodes", static_cast<double>(bvh.getNodes().size()), "");
+    printResult("  memory per instance", static_cast<double>(bvh.getMemoryUsage()) / instanceNumber, "bytes");
+
+    auto projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, farPlane);
+    std::vector<Frustum> frustums;
+    for (int frame = 0; frame < frameNumber; ++frame)
+    {
+        float angle = 2.0f * 3.14159265f * frame / frameNumber;
+        auto front = glm::vec3(std::sin(angle), 0.0f, -std::cos(angle));
+        frustums.push_back(extractFrustum(projection * glm::lookAt(glm::vec3(0.0f), front, glm::vec3(0.0f, 1.0f, 0.0f))));
+    }
+
+    std::vector<std::uint32_t> visible;
+    visible.reserve(instanceNumber);
+    std::size_t visibleTotal = 0;
+    timer.restart();
+    for (const auto& frustum : frustums)
+    {
+        visible.clear();
+        bvh.cullFrustum(frustum, visible);
+        visibleTotal += visible.size();
+    }
+    printResult("  frustum culling, BVH", timer.elapsedMilliseconds() / frameNumber, "ms/frame");
+    printResult("    visible", static_cast<double>(visibleTotal) / frameNumber, "instances/frame");
+
+    FrustumCuller culler;
+    timer.restart();
+    for (const auto& frustum : frustums)
+        culler.cull(frustum, spheres);
+    printResult("  frustum culling, every sphere", timer.elapsedMilliseconds() / frameNumber, "ms/frame");
+
+    std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+    int hitNumber = 0;
+    timer.restart();
+    for (int i = 0; i < rayNumber; ++i)
+    {
+        glm::vec3 origin(position(random), position(random), position(random));
+        RayHit hit;
+        if (bvh.intersectRay(origin, glm::vec3(direction(random), direction(random), direction(random)), farPlane, hit))
+            ++hitNumber;
+    }
+    printResult("  ray queries", timer.elapsedMilliseconds() * 1000.0 / rayNumber, "us/ray");
+    printResult("    hits", 100.0 * hitNumber / rayNumber, "%");
+}
+
+int main()
+{
+    for (auto instanceNumber : instanceNumbers)
+        run(instanceNumber);
+}
@@ -0,0 +1,161 @@
+#include <benchmark.h>
+#include <mapped_file.h>
+#include <shader_source.h>
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+//Compares the way the chapters used to read their files at startup with the memory-mapped
+//reads. The stream path reads the shaders with ifstream -> ostringstream -> std::string and the
+//images with stbi_load, which reads them through stdio. The mapped path passes a view of the
+//mapping to glShaderSource and stbi_load_from_memory. Besides the time we report the bytes
+//copied from the kernel by read() and the number of read() calls, taken from /proc/self/io, the
+//other calls made for each file and the page faults from getrusage(). The mapping trades the
+//read() calls for more calls per file and for the faults taken when the pages are first touched.
+//The files are in the page cache after the first iteration, so this is the warm startup.
+
+const int iterationNumber = 200;
+
+const char* shaderPaths[] = {"shaders/shader.vs", "shaders/shader.fs"};
+const char* imagePaths[] = {"shaders/container.jpg", "shaders/awesomeface.png"};
+const int fileNumber = 4;
+
+struct IoCounters
+{
+    unsigned long long readBytes;
+    unsigned long long readCalls;
+    unsigned long long pageFaults;
+};
+
+//Returns false if the counters are not available, i.e. not on Linux
+bool getIoCounters(IoCounters& counters)
+{
+#ifdef _WIN32
+    return false;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return false;
+    counters.pageFaults = static_cast<unsigned long long>(usage.ru_minflt + usage.ru_majflt);
+    std::ifstream file("/proc/self/io");
+    if (!file)
+        return false;
+    counters.readBytes = counters.readCalls = 0;
+    std::string name;
+    unsigned long long value;
+    while (file >> name >> value)
+    {
+        if (name == "rchar:")
+            counters.readBytes = value;
+        else if (name == "syscr:")
+            counters.readCalls = value;
+    }
+    return true;
+#endif
+}
+
+//Returns the sum of the sizes, so the compiler cannot drop the reads
+std::size_t loadWithStreams()
+{
+    std::size_t total = 0;
+    for (auto path : shaderPaths)
+    {
+        std::ifstream shaderFile;
+        shaderFile.exceptions(std::ifstream::badbit | std::ifstream::failbit);
+        shaderFile.open(path);
+        std::ostringstream os;
+        os << shaderFile.rdbuf();
+        std::string code = os.str();
+        total += code.size();
+    }
+    for (auto path : imagePaths)
+    {
+        int width, height, channelNumber;
+        auto data = stbi_load(path, &width, &height, &channelNumber, 0);
+        if (data == NULL)
+            throw std::string("Cannot load ") + path;
+        total += static_cast<std::size_t>(width * height * channelNumber);
+        stbi_image_free(data);
+    }
+    return total;
+}
+
+std::size_t loadWithMapping()
+{
+    std::size_t total = 0;
+    for (auto path : shaderPaths)
+    {
+        MappedFile file;
+        auto code = loadShaderSource(path, file, false);
+        total += code.size;
+    }
+    for (auto path : imagePaths)
+    {
+        int width, height, channelNumber;
+        MappedFile file(path);
+        auto data = file.isOpen() ? stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.getData()),
+            static_cast<int>(file.getSize()), &width, &height, &channelNumber, 0) : NULL;
+        if (data == NULL)
+            throw std::string("Cannot load ") + path;
+        total += static_cast<std::size_t>(width * height * channelNumber);
+        stbi_image_free(data);
+    }
+    return total;
+}
+
+//otherCalls are the calls made for each file besides read(), which /proc/self/io doesn't count
+void measure(const char* name, std::size_t (*loadFunction)(), int otherCalls, const char* otherCallNames)
+{
+    //Warm up the page cache
+    loadFunction();
+
+    IoCounters before, after;
+    bool hasCounters = getIoCounters(before);
+    Timer timer;
+    std::size_t total = 0;
+    for (int i = 0; i < iterationNumber; ++i)
+        total += loadFunction();
+    auto time = timer.elapsedMilliseconds();
+    hasCounters = hasCounters && getIoCounters(after);
+
+    std::cout << name << " (" << total / iterationNumber << " bytes of code and pixels)" << std::endl;
+    printResult("  time", time / iterationNumber, "ms/startup");
+    printResult("  other calls", otherCalls * fileNumber, "calls/startup");
+    std::cout << "    " << otherCallNames << " for each file" << std::endl;
+    if (!hasCounters)
+    {
+        std::cout << "  /proc/self/io is not available" << std::endl;
+        return;
+    }
+    //Reading /proc/self/io itself is one open file with a few read() calls, which is noise here
+    printResult("  bytes copied by read()", static_cast<double>(after.readBytes - before.readBytes) / iterationNumber, "bytes/startup");
+    printResult("  read() calls", static_cast<double>(after.readCalls - before.readCalls) / iterationNumber, "calls/startup");
+    printResult("  page faults", static_cast<double>(after.pageFaults - before.pageFaults) / iterationNumber, "faults/startup");
+}
+
+int main()
+{
+    stbi_set_flip_vertically_on_load(true);
+    std::cout << "Average of " << iterationNumber << " loads of 2 shaders and 2 images" << std::endl;
+    try
+    {
+        //Both streams may also call fstat() or lseek(), so 2 is the least they make
+        measure("ifstream and stbi_load", loadWithStreams, 2, "open() and close()");
+        //See MappedFile::open() and close()
+        measure("MappedFile and stbi_load_from_memory", loadWithMapping, 6, "open(), fstat(), mmap(), madvise(), close() and munmap()");
+    }
+    catch (std::string str)
+    {
+        std::cerr << str << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,114 @@
+#include <benchmark.h>
+#include <frustum_culling.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+#include <random>
+#include <thread>
+#include <string>
+#include <algorithm>
+#include <cmath>
+
+//Culls 1M bounding spheres scattered around a camera which turns a full circle, the way
+//CameraKeyboard culls its cubes. The SoA SIMD culling runs on one thread and on the workers of a
+//JobSystem, and it's compared with a loop over glm::vec4 spheres (center and radius), which is
+//how the instances would be stored without the culling module. It doesn't need an OpenGL
+//context.
+
+const std::size_t sphereNumber = 1000000;
+const int frameNumber = 60;
+
+std::vector<glm::mat4> makeFrames()
+{
+    auto projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+    std::vector<glm::mat4> frames;
+    for (int frame = 0; frame < frameNumber; ++frame)
+    {
+        float angle = 2.0f * 3.14159265f * frame / frameNumber;
+        auto front = glm::vec3(std::sin(angle), 0.0f, -std::cos(angle));
+        frames.push_back(projection * glm::lookAt(glm::vec3(0.0f), front, glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+    return frames;
+}
+
+//The same test as cullSpheres without SIMD and with the spheres as an array of structures
+std::size_t cullArrayOfStructures(const Frustum& frustum, const std::vector<glm::vec4>& spheres, std::vector<std::uint32_t>& visible)
+{
+    visible.clear();
+    for (std::size_t i = 0; i < spheres.size(); ++i)
+    {
+        const auto& sphere = spheres[i];
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; ++p)
+        {
+            const float* plane = frustum.planes[p];
+            inside = sphere.x * plane[0] + sphere.y * plane[1] + sphere.z * plane[2] + plane[3] >= -sphere.w;
+        }
+        if (inside)
+            visible.push_back(static_cast<std::uint32_t>(i));
+    }
+    return visible.size();
+}
+
+int main()
+{
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> position(-150.0f, 150.0f);
+    std::uniform_real_distribution<float> radius(0.5f, 2.0f);
+    BoundingSpheres spheres;
+    std::vector<glm::vec4> sphereStructures;
+    spheres.reserve(sphereNumber);
+    sphereStructures.reserve(sphereNumber);
+    for (std::size_t i = 0; i < sphereNumber; ++i)
+    {
+        glm::vec3 center(position(random), position(random), position(random));
+        float sphereRadius = radius(random);
+        spheres.add(center, sphereRadius);
+        sphereStructures.push_back(glm::vec4(center.x, center.y, center.z, sphereRadius));
+    }
+
+    std::vector<Frustum> frustums;
+    for (const auto& viewProj : makeFrames())
+        frustums.push_back(extractFrustum(viewProj));
+
+#if defined(FRUSTUM_CULLING_AVX)
+    const char* instructionSet = "AVX, 8 spheres per batch";
+#elif defined(FRUSTUM_CULLING_SSE)
+    const char* instructionSet = "SSE, 4 spheres per batch";
+#else
+    const char* instructionSet = "no SIMD";
+#endif
+    std::cout << sphereNumber << " spheres, " << frameNumber << " frames, " << instructionSet << std::endl;
+
+    std::vector<std::uint32_t> visible;
+    std::size_t visibleTotal = 0;
+    Timer timer;
+    for (const auto& frustum : frustums)
+        visibleTotal += cullArrayOfStructures(frustum, sphereStructures, visible);
+    printResult("glm::vec4 array, scalar", timer.elapsedMilliseconds() / frameNumber, "ms/frame");
+    printResult("  visible", static_cast<double>(visibleTotal) / frameNumber, "spheres/frame");
+
+    FrustumCuller culler;
+    //Warm up, so the list is allocated
+    culler.cull(frustums[0], spheres);
+    visibleTotal = 0;
+    timer.restart();
+    for (const auto& frustum : frustums)
+        visibleTotal += culler.cull(frustum, spheres).size();
+    printResult("BoundingSpheres, 1 thread", timer.elapsedMilliseconds() / frameNumber, "ms/frame");
+    printResult("  visible", static_cast<double>(visibleTotal) / frameNumber, "spheres/frame");
+
+    unsigned maxThreadNumber = std::max(2u, std::thread::hardware_concurrency());
+    for (unsigned threadNumber = 2; threadNumber <= maxThreadNumber; threadNumber *= 2)
+    {
+        //The workers are started once, like in a frame loop
+        JobSystem jobs(threadNumber);
+        culler.cullParallel(frustums[0], spheres, jobs);
+        timer.restart();
+        for (const auto& frustum : frustums)
+            culler.cullParallel(frustum, spheres, jobs);
+        std::string name = "BoundingSpheres, " + std::to_string(threadNumber) + " threads";
+        printResult(name.c_str(), timer.elapsedMilliseconds() / frameNumber, "ms/frame");
+    }
+}
@@ -0,0 +1,8 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+
+void main()
+{
+    gl_Position = vec4(aPos * 0.01f, 1.0f);
+}
@@ -0,0 +1,144 @@
+#include <benchmark.h>
+#include <shader_loader.h>
+#include <index_buffer.h>
+
+#include <vector>
+
+//Compares the index memory and the draw time of procedurally generated grids stored as
+//GL_UNSIGNED_INT triangle lists (like the chapters), as lists in the smallest index type and as
+//strips joined by primitive restart. Rasterization is turned off, so the time is spent fetching
+//indices and shading vertices.
+
+const int frameNumber = 20;
+
+struct Grid
+{
+    std::vector<GLfloat> vertices;
+    std::vector<GLuint> indices;
+};
+
+Grid makeGrid(int n)
+{
+    Grid grid;
+    for (int y = 0; y < n; ++y)
+    {
+        for (int x = 0; x < n; ++x)
+        {
+            grid.vertices.push_back(static_cast<GLfloat>(x));
+            grid.vertices.push_back(static_cast<GLfloat>(y));
+            grid.vertices.push_back(0.0f);
+        }
+    }
+    for (int y = 0; y + 1 < n; ++y)
+    {
+        for (int x = 0; x + 1 < n; ++x)
+        {
+            GLuint i = static_cast<GLuint>(y * n + x);
+            GLuint quad[] = {i, i + 1, i + n, i + 1, i + n + 1, i + n};
+            grid.indices.insert(grid.indices.end(), quad, quad + 6);
+        }
+    }
+    return grid;
+}
+
+const char* getTypeName(GLenum type)
+{
+    return type == GL_UNSIGNED_BYTE ? "GL_UNSIGNED_BYTE" : (type == GL_UNSIGNED_SHORT ? "GL_UNSIGNED_SHORT" : "GL_UNSIGNED_INT");
+}
+
+double measure(GLFWwindow* window, GLuint vao, GLuint ebo, const IndexBufferData& indices, int drawsPerFrame)
+{
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    indices.upload();
+    //The restart state is set by the first draw, the cache drops it from the rest
+    GLStateCache state;
+    //Warm up
+    indices.draw(&state);
+    glFinish();
+
+    Timer timer;
+    for (int frame = 0; frame < frameNumber; ++frame)
+    {
+        for (int i = 0; i < drawsPerFrame; ++i)
+            indices.draw(&state);
+        glfwSwapBuffers(window);
+        glFinish();
+    }
+    return timer.elapsedMilliseconds() / frameNumber;
+}
+
+void runGrid(GLFWwindow* window, int n, int drawsPerFrame)
+{
+    auto grid = makeGrid(n);
+    auto vertexCount = grid.vertices.size() / 3;
+
+    GLuint vao, vbo, ebo;
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ebo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, grid.vertices.size() * sizeof(GLfloat), grid.vertices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, false, 3 * sizeof(GLfloat), (void*)NULL);
+    glEnableVertexAttribArray(0);
+
+    auto uintList = packIndices(grid.indices, GL_TRIANGLES, GL_UNSIGNED_INT, false);
+    auto packedList = buildIndexBuffer(grid.indices.data(), grid.indices.size(), vertexCount);
+    auto strips = buildIndexBuffer(grid.indices.data(), grid.indices.size(), vertexCount, true);
+
+    std::cout << n << "x" << n << " grid, " << vertexCount << " vertices, " << grid.indices.size() / 3
+              << " triangles, " << drawsPerFrame << " draws per frame" << std::endl;
+    struct Variant
+    {
+        const char* name;
+        const IndexBufferData* indices;
+    };
+    Variant variants[] =
+    {
+        {"  GL_UNSIGNED_INT list", &uintList},
+        {"  smallest type list", &packedList},
+        {"  strips with primitive restart", &strips}
+    };
+    for (const auto& variant : variants)
+    {
+        auto time = measure(window, vao, ebo, *variant.indices, drawsPerFrame);
+        std::cout << variant.name << " (" << getTypeName(variant.indices->type) << ", "
+                  << variant.indices->count << " indices)" << std::endl;
+        printResult("    index memory", static_cast<double>(variant.indices->getSize()), "bytes");
+        printResult("    saved", 100.0 - 100.0 * variant.indices->getSize() / uintList.getSize(), "%");
+        printResult("    draw time", time, "ms/frame");
+    }
+
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    glDeleteBuffers(1, &ebo);
+}
+
+int main()
+{
+    auto window = initBenchmarkContext();
+    if (window == NULL)
+        return 1;
+
+    ShaderLoader shader("shaders/shader.vs", "shaders/shader.fs");
+    try
+    {
+        shader.linkShaders();
+    }
+    catch (std::string str)
+    {
+        std::cerr << str << std::endl;
+        return 1;
+    }
+    shader.use();
+    glEnable(GL_RASTERIZER_DISCARD);
+
+    //Byte, short and int indices
+    runGrid(window, 15, 10000);
+    runGrid(window, 200, 100);
+    runGrid(window, 1000, 4);
+
+    glDisable(GL_RASTERIZER_DISCARD);
+    glfwTerminate();
+}
@@ -0,0 +1,21 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProj;
+};
+
+#ifdef INSTANCING
+layout (location = 3) in mat4 model;
+#else
+uniform mat4 model;
+#endif
+
+void main()
+{
+    gl_Position = viewProj * model * vec4(aPos, 1.0f);
+}
@@ -0,0 +1,172 @@
+#include <benchmark.h>
+#include <shader_loader.h>
+#include <camera_uniforms.h>
+#include <instance_buffer.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+//Sweeps the number of cubes from 10 to 1M and compares the frame time of the per-draw path
+//(setMat4 + glDrawElements for each cube, like the chapters' cubePositions loop) with one
+//glDrawElementsInstanced reading the model matrices from an InstanceBuffer. The frame time
+//includes glFinish, so it's the time the driver needs to execute the frame, which is what
+//matters with a software rasterizer like llvmpipe. The window is small to keep the fill cost
+//low, the cubes only cover a few pixels each.
+
+const int instanceNumbers[] = {10, 100, 1000, 10000, 100000, 1000000};
+
+void setupCube(GLuint& vao, GLuint& vbo, GLuint& ebo)
+{
+    GLfloat vertices[] =
+    {
+        -0.5f, -0.5f, -0.5f,
+        0.5f, -0.5f, -0.5f,
+        0.5f, 0.5f, -0.5f,
+        -0.5f, 0.5f, -0.5f,
+        -0.5f, -0.5f, 0.5f,
+        0.5f, -0.5f, 0.5f,
+        0.5f, 0.5f, 0.5f,
+        -0.5f, 0.5f, 0.5f
+    };
+    GLuint indices[] =
+    {
+        0, 1, 2, 2, 3, 0,
+        4, 5, 6, 6, 7, 4,
+        0, 4, 7, 7, 3, 0,
+        1, 5, 6, 6, 2, 1,
+        3, 2, 6, 6, 7, 3,
+        0, 1, 5, 5, 4, 0
+    };
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ebo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, false, 3 * sizeof(GLfloat), (void*)NULL);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+}
+
+//Puts the cubes on a grid filling [-1, 1]^3
+std::vector<glm::mat4> getModels(int instanceNumber)
+{
+    int side = static_cast<int>(std::ceil(std::cbrt(static_cast<double>(instanceNumber))));
+    float step = 2.0f / side;
+    std::vector<glm::mat4> models(instanceNumber);
+    for (int i = 0; i < instanceNumber; ++i)
+    {
+        glm::vec3 position(-1.0f + step * (i % side + 0.5f), -1.0f + step * (i / side % side + 0.5f),
+            -1.0f + step * (i / (side * side) + 0.5f));
+        glm::mat4 model;
+        model = glm::translate(model, position);
+        model = glm::rotate(model, glm::radians(20.0f * i), glm::vec3(1.0f, 0.3f, 0.5f));
+        models[i] = glm::scale(model, glm::vec3(step * 0.5f));
+    }
+    return models;
+}
+
+//Fewer frames for the large counts, the per-draw path takes seconds per frame there
+int getFrameNumber(int instanceNumber)
+{
+    return std::max(3, std::min(100, 1000000 / instanceNumber));
+}
+
+double renderPerDraw(GLFWwindow* window, ShaderLoader& shader, const std::vector<glm::mat4>& models, int frameNumber)
+{
+    shader.use();
+    Timer timer;
+    for (int frame = 0; frame < frameNumber; ++frame)
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        for (const auto& model : models)
+        {
+            shader.setMat4("model", model);
+            glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, NULL);
+        }
+        glfwSwapBuffers(window);
+        glFinish();
+    }
+    return timer.elapsedMilliseconds() / frameNumber;
+}
+
+double renderInstanced(GLFWwindow* window, ShaderLoader& shader, const InstanceBuffer& instances, int frameNumber)
+{
+    shader.use();
+    Timer timer;
+    for (int frame = 0; frame < frameNumber; ++frame)
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        instances.draw(GL_TRIANGLES, 36, GL_UNSIGNED_INT);
+        glfwSwapBuffers(window);
+        glFinish();
+    }
+    return timer.elapsedMilliseconds() / frameNumber;
+}
+
+int main()
+{
+    auto window = initBenchmarkContext(128, 128);
+    if (window == NULL)
+        return 1;
+
+    ShaderLoader perDrawShader("shaders/shader.vs", "shaders/shader.fs");
+    ShaderLoader instancedShader("shaders/shader.vs", "shaders/shader.fs");
+    instancedShader.addDefine("INSTANCING");
+    try
+    {
+        perDrawShader.linkShaders();
+        instancedShader.linkShaders();
+    }
+    catch (std::string str)
+    {
+        std::cerr << str << std::endl;
+        return 1;
+    }
+
+    GLuint vao, vbo, ebo;
+    setupCube(vao, vbo, ebo);
+    InstanceBuffer instances;
+    instances.attach(vao);
+    glBindVertexArray(vao);
+    glEnable(GL_DEPTH_TEST);
+
+    CameraUniformBuffer camera;
+    camera.update(glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
+        glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 10.0f));
+
+    std::cout << "Renderer: " << reinterpret_cast<const char*>(glGetString(GL_RENDERER)) << std::endl;
+    for (auto instanceNumber : instanceNumbers)
+    {
+        auto models = getModels(instanceNumber);
+        auto frameNumber = getFrameNumber(instanceNumber);
+
+        Timer uploadTimer;
+        instances.update(models.data(), models.size());
+        glFinish();
+        auto uploadTime = uploadTimer.elapsedMilliseconds();
+
+        //Warm up both paths
+        renderPerDraw(window, perDrawShader, models, 1);
+        renderInstanced(window, instancedShader, instances, 1);
+        auto perDrawTime = renderPerDraw(window, perDrawShader, models, frameNumber);
+        auto instancedTime = renderInstanced(window, instancedShader, instances, frameNumber);
+
+        std::cout << instanceNumber << " cubes, average of " << frameNumber << " frames" << std::endl;
+        printResult("  per-draw glDrawElements", perDrawTime, "ms/frame");
+        printResult("  glDrawElementsInstanced", instancedTime, "ms/frame");
+        printResult("  instance buffer upload", uploadTime, "ms");
+        printResult("  speedup", perDrawTime / instancedTime, "x");
+    }
+
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    glDeleteBuffers(1, &ebo);
+    glfwTerminate();
+}
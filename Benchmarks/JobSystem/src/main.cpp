@@ -0,0 +1,234 @@
+#include <benchmark.h>
+#include <job_system.h>
+#include <transform_batch.h>
+#include <frustum_culling.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+#include <random>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <utility>
+#include <cmath>
+#include <cstdint>
+
+//The CPU side of a frame with 1M cubes, the way a scene bigger than the chapters would do it:
+//animate the cubes and compute their matrices, cull them against the view frustum, sort the
+//visible ones front to back and gather their matrices in that order for the instance buffer.
+//The stages are chained with JobSystem::runAfter and each one is a parallelFor, so the same
+//frame runs on 1 to N threads. Every thread number must give the same draw list. It doesn't
+//need an OpenGL context.
+
+const std::size_t cubeNumber = 1000000;
+const int frameNumber = 20;
+const std::size_t chunkSize = 16384;
+
+struct Scene
+{
+    TransformBatch transforms;
+    BoundingSpheres bounds;
+    std::vector<float> baseAngles;
+    std::vector<glm::mat4> models;
+    //cullSpheres writes each chunk's visible cubes at the start of its part of the array
+    std::vector<std::uint32_t> visible;
+    std::vector<std::size_t> chunkVisibleNumbers;
+    std::vector<std::pair<float, std::uint32_t>> depths;
+    std::vector<std::pair<float, std::uint32_t>> mergeBuffer;
+    std::vector<glm::mat4> drawList;
+};
+
+struct StageTimes
+{
+    double animate, cull, sort, gather, frame;
+};
+
+void animate(JobSystem& jobs, Scene& scene, float time)
+{
+    jobs.parallelFor(0, cubeNumber, chunkSize, [&scene, time](std::size_t begin, std::size_t end)
+    {
+        auto angles = scene.transforms.getAngles();
+        for (auto i = begin; i < end; ++i)
+            angles[i] = scene.baseAngles[i] + (i % 3 == 0 ? time : 0.0f);
+        computeTransforms(scene.transforms, begin, end, glm::value_ptr(scene.models[begin]));
+    });
+}
+
+void cull(JobSystem& jobs, Scene& scene, const Frustum& frustum, const glm::vec3& eye, const glm::vec3& front)
+{
+    auto chunkNumber = (cubeNumber + chunkSize - 1) / chunkSize;
+    jobs.parallelFor(0, chunkNumber, 1, [&scene, &frustum](std::size_t begin, std::size_t end)
+    {
+        for (auto chunk = begin; chunk < end; ++chunk)
+        {
+            auto first = chunk * chunkSize;
+            scene.chunkVisibleNumbers[chunk] = cullSpheres(frustum, scene.bounds, first, std::min(cubeNumber, first + chunkSize),
+                scene.visible.data() + first);
+        }
+    });
+    //Packs the chunks, then computes the view depths
+    std::size_t visibleNumber = 0;
+    for (std::size_t chunk = 0; chunk < chunkNumber; ++chunk)
+    {
+        auto first = scene.visible.begin() + chunk * chunkSize;
+        std::copy(first, first + scene.chunkVisibleNumbers[chunk], scene.visible.begin() + visibleNumber);
+        visibleNumber += scene.chunkVisibleNumbers[chunk];
+    }
+    scene.depths.resize(visibleNumber);
+    jobs.parallelFor(0, visibleNumber, chunkSize, [&scene, &eye, &front](std::size_t begin, std::size_t end)
+    {
+        auto x = scene.bounds.getX(), y = scene.bounds.getY(), z = scene.bounds.getZ();
+        for (auto i = begin; i < end; ++i)
+        {
+            auto cube = scene.visible[i];
+            float depth = (x[cube] - eye.x) * front.x + (y[cube] - eye.y) * front.y + (z[cube] - eye.z) * front.z;
+            scene.depths[i] = std::make_pair(depth, cube);
+        }
+    });
+}
+
+//Sorts chunks, then merges pairs of runs until one is left, each pass a parallelFor
+void sortFrontToBack(JobSystem& jobs, Scene& scene)
+{
+    auto& depths = scene.depths;
+    auto& buffer = scene.mergeBuffer;
+    buffer.resize(depths.size());
+    auto chunkNumber = (depths.size() + chunkSize - 1) / chunkSize;
+    jobs.parallelFor(0, chunkNumber, 1, [&depths](std::size_t begin, std::size_t end)
+    {
+        for (auto chunk = begin; chunk < end; ++chunk)
+            std::sort(depths.begin() + chunk * chunkSize, depths.begin() + std::min(depths.size(), (chunk + 1) * chunkSize));
+    });
+    for (std::size_t run = chunkSize; run < depths.size(); run *= 2)
+    {
+        auto pairNumber = (depths.size() + 2 * run - 1) / (2 * run);
+        jobs.parallelFor(0, pairNumber, 1, [&depths, &buffer, run](std::size_t begin, std::size_t end)
+        {
+            for (auto pair = begin; pair < end; ++pair)
+            {
+                auto first = pair * 2 * run;
+                auto middle = std::min(depths.size(), first + run);
+                auto last = std::min(depths.size(), first + 2 * run);
+                std::merge(depths.begin() + first, depths.begin() + middle, depths.begin() + middle, depths.begin() + last,
+                    buffer.begin() + first);
+            }
+        });
+        depths.swap(buffer);
+    }
+}
+
+void gather(JobSystem& jobs, Scene& scene)
+{
+    scene.drawList.resize(scene.depths.size());
+    jobs.parallelFor(0, scene.depths.size(), chunkSize, [&scene](std::size_t begin, std::size_t end)
+    {
+        for (auto i = begin; i < end; ++i)
+            scene.drawList[i] = scene.models[scene.depths[i].second];
+    });
+}
+
+StageTimes runFrames(unsigned threadNumber, Scene& scene, const std::vector<glm::mat4>& views, const glm::mat4& projection)
+{
+    JobSystem jobs(threadNumber);
+    StageTimes times = {0.0, 0.0, 0.0, 0.0, 0.0};
+    for (int frame = 0; frame < frameNumber; ++frame)
+    {
+        float time = frame / 60.0f;
+        auto frustum = extractFrustum(projection * views[frame]);
+        glm::vec3 eye(0.0f, 0.0f, 0.0f);
+        glm::vec3 front(-views[frame][0][2], -views[frame][1][2], -views[frame][2][2]);
+
+        //Each stage alone, then the whole frame as a chain of jobs
+        Timer timer;
+        animate(jobs, scene, time);
+        times.animate += timer.elapsedMilliseconds();
+        timer.restart();
+        cull(jobs, scene, frustum, eye, front);
+        times.cull += timer.elapsedMilliseconds();
+        timer.restart();
+        sortFrontToBack(jobs, scene);
+        times.sort += timer.elapsedMilliseconds();
+        timer.restart();
+        gather(jobs, scene);
+        times.gather += timer.elapsedMilliseconds();
+
+        timer.restart();
+        JobCounter animated, culled, sorted, gathered;
+        jobs.run([&]() { animate(jobs, scene, time); }, &animated);
+        jobs.runAfter(animated, [&]() { cull(jobs, scene, frustum, eye, front); }, &culled);
+        jobs.runAfter(culled, [&]() { sortFrontToBack(jobs, scene); }, &sorted);
+        jobs.runAfter(sorted, [&]() { gather(jobs, scene); }, &gathered);
+        //The OpenGL thread would upload scene.drawList now
+        jobs.wait(gathered);
+        times.frame += timer.elapsedMilliseconds();
+    }
+    times.animate /= frameNumber;
+    times.cull /= frameNumber;
+    times.sort /= frameNumber;
+    times.gather /= frameNumber;
+    times.frame /= frameNumber;
+    return times;
+}
+
+int main()
+{
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+    std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+    Scene scene;
+    scene.transforms.reserve(cubeNumber);
+    scene.bounds.reserve(cubeNumber);
+    for (std::size_t i = 0; i < cubeNumber; ++i)
+    {
+        glm::vec3 center(position(random), position(random), position(random));
+        scene.baseAngles.push_back(angle(random));
+        scene.transforms.add(center, glm::vec3(direction(random), direction(random), 1.0f), scene.baseAngles.back());
+        scene.bounds.add(center, 0.8661f);
+    }
+    scene.models.resize(cubeNumber);
+    scene.visible.resize(cubeNumber);
+    scene.chunkVisibleNumbers.resize((cubeNumber + chunkSize - 1) / chunkSize);
+
+    auto projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 400.0f);
+    std::vector<glm::mat4> views;
+    for (int frame = 0; frame < frameNumber; ++frame)
+    {
+        float turn = 2.0f * 3.14159265f * frame / frameNumber;
+        views.push_back(glm::lookAt(glm::vec3(0.0f), glm::vec3(std::sin(turn), 0.0f, -std::cos(turn)), glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+    std::cout << cubeNumber << " cubes, " << frameNumber << " frames, " << getTransformKernelName(getTransformKernel())
+              << " transforms" << std::endl;
+
+    std::vector<unsigned> threadNumbers;
+    unsigned maxThreadNumber = std::max(2u, std::thread::hardware_concurrency());
+    for (unsigned threadNumber = 1; threadNumber < maxThreadNumber; threadNumber *= 2)
+        threadNumbers.push_back(threadNumber);
+    threadNumbers.push_back(maxThreadNumber);
+
+    double singleThreadFrame = 0.0;
+    std::vector<glm::mat4> reference;
+    for (auto threadNumber : threadNumbers)
+    {
+        auto times = runFrames(threadNumber, scene, views, projection);
+        std::cout << threadNumber << (threadNumber == 1 ? " thread" : " threads") << std::endl;
+        printResult("  animation and transforms", times.animate, "ms/frame");
+        printResult("  frustum culling and depths", times.cull, "ms/frame");
+        printResult("  front to back sort", times.sort, "ms/frame");
+        printResult("  draw list", times.gather, "ms/frame");
+        printResult("  whole frame, chained jobs", times.frame, "ms/frame");
+        if (threadNumber == 1)
+        {
+            singleThreadFrame = times.frame;
+            reference = scene.drawList;
+        }
+        else
+        {
+            printResult("  speedup", singleThreadFrame / times.frame, "x");
+            bool identical = scene.drawList.size() == reference.size() &&
+                std::equal(reference.begin(), reference.end(), scene.drawList.begin());
+            std::cout << "  same draw list as 1 thread: " << (identical ? "yes" : "no") << std::endl;
+        }
+    }
+}
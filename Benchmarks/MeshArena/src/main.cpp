@@ -0,0 +1,253 @@
+#include <benchmark.h>
+#include <shader_loader.h>
+#include <mesh_arena.h>
+
+#include <vector>
+#include <random>
+#include <algorithm>
+
+//Loads and unloads thousands of meshes of random sizes, once with a VAO, VBO and EBO per mesh
+//(the way setupVAO does it) and once in a MeshArena, then draws the meshes which are still
+//loaded. Both runs do the same sequence of operations.
+
+const int templateNumber = 32;
+const int operationNumber = 20000;
+const int maxLiveMeshes = 1000;
+const int frameNumber = 20;
+const std::size_t vertexCapacity = 1 << 20;
+const std::size_t indexCapacity = 6 << 20;
+
+struct Mesh
+{
+    std::vector<GLfloat> vertices;
+    std::vector<GLuint> indices;
+
+    std::size_t getVertexCount() const
+    {
+        return vertices.size() / 3;
+    }
+};
+
+//A grid of n * n vertices in the xy plane
+Mesh makeGrid(int n)
+{
+    Mesh mesh;
+    for (int y = 0; y < n; ++y)
+    {
+        for (int x = 0; x < n; ++x)
+        {
+            mesh.vertices.push_back(static_cast<GLfloat>(x));
+            mesh.vertices.push_back(static_cast<GLfloat>(y));
+            mesh.vertices.push_back(0.0f);
+        }
+    }
+    for (int y = 0; y + 1 < n; ++y)
+    {
+        for (int x = 0; x + 1 < n; ++x)
+        {
+            GLuint i = static_cast<GLuint>(y * n + x);
+            GLuint quad[] = {i, i + 1, i + n, i + 1, i + n + 1, i + n};
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+        }
+    }
+    return mesh;
+}
+
+struct Operation
+{
+    //-1 to unload the live mesh at slot
+    int templateIndex;
+    int slot;
+};
+
+//Loads until maxLiveMeshes are live, then loads and unloads randomly
+std::vector<Operation> makeOperations()
+{
+    std::mt19937 random(42);
+    std::vector<Operation> operations;
+    int live = 0;
+    for (int i = 0; i < operationNumber; ++i)
+    {
+        Operation operation;
+        if (live < maxLiveMeshes && (live == 0 || random() % 2 == 0))
+        {
+            operation.templateIndex = static_cast<int>(random() % templateNumber);
+            operation.slot = live++;
+        }
+        else
+        {
+            operation.templateIndex = -1;
+            operation.slot = static_cast<int>(random() % live);
+            --live;
+        }
+        operations.push_back(operation);
+    }
+    return operations;
+}
+
+struct SeparateMesh
+{
+    GLuint vao, vbo, ebo;
+    GLsizei indexCount;
+};
+
+SeparateMesh loadSeparate(const Mesh& mesh)
+{
+    SeparateMesh result;
+    glGenVertexArrays(1, &result.vao);
+    glGenBuffers(1, &result.vbo);
+    glGenBuffers(1, &result.ebo);
+    glBindVertexArray(result.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, result.vbo);
+    glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(GLfloat), mesh.vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, result.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(GLuint), mesh.indices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, false, 3 * sizeof(GLfloat), (void*)NULL);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+    result.indexCount = static_cast<GLsizei>(mesh.indices.size());
+    return result;
+}
+
+void unloadSeparate(SeparateMesh& mesh)
+{
+    glDeleteVertexArrays(1, &mesh.vao);
+    glDeleteBuffers(1, &mesh.vbo);
+    glDeleteBuffers(1, &mesh.ebo);
+}
+
+//Removes the element at slot by moving the last one there, like the operations expect
+template <typename T>
+void removeSlot(std::vector<T>& live, int slot)
+{
+    live[slot] = live.back();
+    live.pop_back();
+}
+
+void runSeparate(GLFWwindow* window, const std::vector<Mesh>& templates, const std::vector<Operation>& operations)
+{
+    std::vector<SeparateMesh> live;
+    Timer timer;
+    for (const auto& operation : operations)
+    {
+        if (operation.templateIndex >= 0)
+            live.push_back(loadSeparate(templates[operation.templateIndex]));
+        else
+        {
+            unloadSeparate(live[operation.slot]);
+            removeSlot(live, operation.slot);
+        }
+    }
+    glFinish();
+    auto loadTime = timer.elapsedMilliseconds();
+
+    timer.restart();
+    for (int frame = 0; frame < frameNumber; ++frame)
+    {
+        glClear(GL_COLOR_BUFFER_BIT);
+        for (const auto& mesh : live)
+        {
+            glBindVertexArray(mesh.vao);
+            glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, NULL);
+        }
+        glfwSwapBuffers(window);
+        glFinish();
+    }
+    auto drawTime = timer.elapsedMilliseconds() / frameNumber;
+
+    std::cout << "VAO, VBO and EBO per mesh (" << live.size() << " meshes left)" << std::endl;
+    printResult("  load and unload", loadTime * 1000.0 / operations.size(), "us/operation");
+    printResult("  draw", drawTime, "ms/frame");
+    for (auto& mesh : live)
+        unloadSeparate(mesh);
+}
+
+void runArena(GLFWwindow* window, const std::vector<Mesh>& templates, const std::vector<Operation>& operations)
+{
+    MeshArena arena(3 * sizeof(GLfloat), vertexCapacity, indexCapacity);
+    glBindVertexArray(arena.getVertexArray());
+    glVertexAttribPointer(0, 3, GL_FLOAT, false, 3 * sizeof(GLfloat), (void*)NULL);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+
+    std::vector<MeshRange> live;
+    double maxFragmentation = 0.0;
+    Timer timer;
+    for (const auto& operation : operations)
+    {
+        if (operation.templateIndex >= 0)
+        {
+            const auto& mesh = templates[operation.templateIndex];
+            MeshRange range = {0, 0, 0, 0};
+            arena.allocate(mesh.vertices.data(), mesh.getVertexCount(), mesh.indices.data(), mesh.indices.size(), range);
+            //A failed allocation keeps an empty range, so the slots match the other run
+            live.push_back(range);
+        }
+        else
+        {
+            arena.free(live[operation.slot]);
+            removeSlot(live, operation.slot);
+        }
+        maxFragmentation = std::max(maxFragmentation, arena.getFragmentation());
+    }
+    glFinish();
+    auto loadTime = timer.elapsedMilliseconds();
+
+    timer.restart();
+    for (int frame = 0; frame < frameNumber; ++frame)
+    {
+        glClear(GL_COLOR_BUFFER_BIT);
+        //One VAO for every mesh
+        glBindVertexArray(arena.getVertexArray());
+        for (const auto& range : live)
+        {
+            if (range.indexCount > 0)
+                arena.draw(range);
+        }
+        glfwSwapBuffers(window);
+        glFinish();
+    }
+    auto drawTime = timer.elapsedMilliseconds() / frameNumber;
+
+    auto stats = arena.getStats();
+    std::cout << "MeshArena (" << live.size() << " meshes left)" << std::endl;
+    printResult("  load and unload", loadTime * 1000.0 / operations.size(), "us/operation");
+    printResult("  allocator and uploads", stats.allocationMilliseconds * 1000.0 / operations.size(), "us/operation");
+    printResult("  draw", drawTime, "ms/frame");
+    printResult("  failed allocations", stats.failedAllocations, "");
+    printResult("  vertex usage", 100.0 * stats.vertices.used / stats.vertices.capacity, "%");
+    printResult("  free vertex ranges", static_cast<double>(stats.vertices.freeRangeNumber), "");
+    printResult("  fragmentation at the end", arena.getFragmentation(), "");
+    printResult("  highest fragmentation", maxFragmentation, "");
+}
+
+int main()
+{
+    auto window = initBenchmarkContext();
+    if (window == NULL)
+        return 1;
+
+    ShaderLoader shader("shaders/shader.vs", "shaders/shader.fs");
+    try
+    {
+        shader.linkShaders();
+    }
+    catch (std::string str)
+    {
+        std::cerr << str << std::endl;
+        return 1;
+    }
+    shader.use();
+
+    std::mt19937 random(7);
+    std::vector<Mesh> templates;
+    for (int i = 0; i < templateNumber; ++i)
+        templates.push_back(makeGrid(4 + static_cast<int>(random() % 37)));
+    auto operations = makeOperations();
+
+    std::cout << operationNumber << " loads and unloads of " << templateNumber << " grid meshes, up to "
+              << maxLiveMeshes << " at a time" << std::endl;
+    runSeparate(window, templates, operations);
+    runArena(window, templates, operations);
+    glfwTerminate();
+}
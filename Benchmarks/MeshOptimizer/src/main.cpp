@@ -0,0 +1,139 @@
+#include <benchmark.h>
+#include <vertex_format.h>
+#include <mesh_optimizer.h>
+
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+//Reports the ACMR and ATVR of large procedural meshes before and after each pass of the mesh
+//optimizer, with the FIFO cache sizes of common GPUs, and how long the passes take. The input
+//orders are a row-by-row grid (the order most generators and exporters use), the same grid
+//with shuffled triangles (a bad exporter) and a UV sphere. It doesn't need an OpenGL context.
+
+const std::size_t cacheSizes[] = {16, 32};
+
+struct Mesh
+{
+    const char* name;
+    std::vector<FloatVertex> vertices;
+    std::vector<GLuint> indices;
+};
+
+FloatVertex makeVertex(float x, float y, float z, float u, float v)
+{
+    FloatVertex vertex = {{x, y, z}, {u, v, 1.0f}, {u, v}};
+    return vertex;
+}
+
+Mesh makeGrid(int n)
+{
+    Mesh mesh;
+    mesh.name = "grid";
+    for (int y = 0; y < n; ++y)
+    {
+        for (int x = 0; x < n; ++x)
+        {
+            float u = static_cast<float>(x) / (n - 1), v = static_cast<float>(y) / (n - 1);
+            mesh.vertices.push_back(makeVertex(u, v, 0.0f, u, v));
+        }
+    }
+    for (int y = 0; y + 1 < n; ++y)
+    {
+        for (int x = 0; x + 1 < n; ++x)
+        {
+            GLuint i = static_cast<GLuint>(y * n + x);
+            GLuint quad[] = {i, i + 1, i + n, i + 1, i + n + 1, i + n};
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+        }
+    }
+    return mesh;
+}
+
+Mesh makeShuffledGrid(int n)
+{
+    auto mesh = makeGrid(n);
+    mesh.name = "grid with shuffled triangles";
+    std::vector<std::size_t> order(mesh.indices.size() / 3);
+    for (std::size_t t = 0; t < order.size(); ++t)
+        order[t] = t;
+    std::mt19937 random(42);
+    std::shuffle(order.begin(), order.end(), random);
+    std::vector<GLuint> indices;
+    for (auto t : order)
+        indices.insert(indices.end(), mesh.indices.begin() + t * 3, mesh.indices.begin() + t * 3 + 3);
+    mesh.indices.swap(indices);
+    return mesh;
+}
+
+Mesh makeSphere(int rings, int segments)
+{
+    const float pi = 3.14159265358979f;
+    Mesh mesh;
+    mesh.name = "UV sphere";
+    for (int ring = 0; ring <= rings; ++ring)
+    {
+        float v = static_cast<float>(ring) / rings;
+        for (int segment = 0; segment <= segments; ++segment)
+        {
+            float u = static_cast<float>(segment) / segments;
+            float theta = v * pi, phi = u * 2.0f * pi;
+            mesh.vertices.push_back(makeVertex(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi), u, v));
+        }
+    }
+    GLuint stride = static_cast<GLuint>(segments + 1);
+    for (int ring = 0; ring < rings; ++ring)
+    {
+        for (int segment = 0; segment < segments; ++segment)
+        {
+            GLuint i = static_cast<GLuint>(ring) * stride + segment;
+            GLuint quad[] = {i, i + stride, i + 1, i + 1, i + stride, i + stride + 1};
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+        }
+    }
+    return mesh;
+}
+
+void printCacheStats(const char* stage, const Mesh& mesh)
+{
+    std::cout << "  " << stage << std::endl;
+    for (auto cacheSize : cacheSizes)
+    {
+        auto stats = analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size(), cacheSize);
+        std::string prefix = "    FIFO " + std::to_string(cacheSize) + " ";
+        printResult((prefix + "ACMR").c_str(), stats.acmr, "");
+        printResult((prefix + "ATVR").c_str(), stats.atvr, "");
+    }
+}
+
+void run(Mesh mesh)
+{
+    std::cout << mesh.name << ", " << mesh.vertices.size() << " vertices, " << mesh.indices.size() / 3 << " triangles" << std::endl;
+    printCacheStats("input order", mesh);
+
+    Timer timer;
+    mesh.indices = optimizeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+    auto cacheTime = timer.elapsedMilliseconds();
+    printCacheStats("after optimizeVertexCache", mesh);
+
+    timer.restart();
+    optimizeOverdraw(mesh.indices, mesh.vertices[0].position, sizeof(FloatVertex), mesh.vertices.size());
+    auto overdrawTime = timer.elapsedMilliseconds();
+    printCacheStats("after optimizeOverdraw", mesh);
+
+    timer.restart();
+    optimizeVertexFetch(mesh.vertices.data(), mesh.vertices.size(), sizeof(FloatVertex), mesh.indices.data(), mesh.indices.size());
+    auto fetchTime = timer.elapsedMilliseconds();
+
+    printResult("  optimizeVertexCache", cacheTime, "ms");
+    printResult("  optimizeOverdraw", overdrawTime, "ms");
+    printResult("  optimizeVertexFetch", fetchTime, "ms");
+}
+
+int main()
+{
+    run(makeGrid(512));
+    run(makeShuffledGrid(512));
+    run(makeSphere(256, 512));
+}
@@ -0,0 +1,108 @@
+#include <benchmark.h>
+#include <occlusion_culler.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+#include <random>
+#include <thread>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+
+//A street of cubes behind three large walls: the camera looks down the street and most cubes are
+//hidden. The walls are rasterized into the 256x128 depth buffer on one thread and on the workers
+//of a JobSystem, which must give the same buffer and the same visible cubes. It doesn't need an OpenGL context.
+
+const std::size_t cubeNumber = 20000;
+const int frameNumber = 100;
+
+const glm::vec3 cubeCorners[8] = {
+    glm::vec3(-0.5f, -0.5f, -0.5f), glm::vec3(0.5f, -0.5f, -0.5f), glm::vec3(-0.5f, 0.5f, -0.5f), glm::vec3(0.5f, 0.5f, -0.5f),
+    glm::vec3(-0.5f, -0.5f, 0.5f), glm::vec3(0.5f, -0.5f, 0.5f), glm::vec3(-0.5f, 0.5f, 0.5f), glm::vec3(0.5f, 0.5f, 0.5f)
+};
+
+const std::uint32_t cubeIndices[36] = {
+    0, 2, 1, 1, 2, 3,
+    4, 5, 6, 5, 7, 6,
+    0, 1, 4, 1, 5, 4,
+    2, 6, 3, 3, 6, 7,
+    0, 4, 2, 2, 4, 6,
+    1, 3, 5, 3, 7, 5
+};
+
+//Centers and sizes of the walls, which are scaled unit cubes
+const glm::vec3 wallCenters[3] = {glm::vec3(-12.0f, 0.0f, -30.0f), glm::vec3(12.0f, 0.0f, -30.0f), glm::vec3(0.0f, 2.0f, -45.0f)};
+const glm::vec3 wallSizes[3] = {glm::vec3(22.0f, 30.0f, 1.0f), glm::vec3(22.0f, 30.0f, 1.0f), glm::vec3(10.0f, 26.0f, 1.0f)};
+
+struct Result
+{
+    std::vector<float> depths;
+    std::vector<std::uint32_t> visible;
+};
+
+Result run(const glm::mat4& viewProj, const std::vector<Aabb>& cubes, unsigned threadNumber)
+{
+    //The workers are started once, like in a renderer, not every frame
+    JobSystem jobs(threadNumber);
+    OcclusionCuller culler;
+    Result result;
+    Timer timer;
+    for (int frame = 0; frame < frameNumber; ++frame)
+    {
+        culler.beginFrame(viewProj);
+        for (int wall = 0; wall < 3; ++wall)
+        {
+            auto model = glm::scale(glm::translate(glm::mat4(1.0f), wallCenters[wall]), wallSizes[wall]);
+            culler.addOccluder(cubeCorners, 8, cubeIndices, 36, model);
+        }
+        culler.rasterize(jobs);
+    }
+    std::string name = "rasterization and pyramid, " + std::to_string(threadNumber) + (threadNumber == 1 ? " thread" : " threads");
+    printResult(name.c_str(), timer.elapsedMilliseconds() * 1000.0 / frameNumber, "us/frame");
+
+    timer.restart();
+    for (int frame = 0; frame < frameNumber; ++frame)
+        culler.cull(cubes.data(), cubes.size(), result.visible);
+    printResult("  occlusion tests", timer.elapsedMilliseconds() * 1000.0 / frameNumber, "us/frame");
+    printResult("  hidden", 100.0 * (cubes.size() - result.visible.size()) / cubes.size(), "%");
+    result.depths = culler.getDepths();
+    return result;
+}
+
+int main()
+{
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> x(-40.0f, 40.0f), y(-10.0f, 10.0f), z(-100.0f, -5.0f);
+    std::uniform_real_distribution<float> halfSize(0.25f, 1.0f);
+    std::vector<Aabb> cubes(cubeNumber);
+    for (auto& box : cubes)
+    {
+        glm::vec3 center(x(random), y(random), z(random));
+        float size = halfSize(random);
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            box.min[axis] = center[axis] - size;
+            box.max[axis] = center[axis] + size;
+        }
+    }
+
+#if defined(OCCLUSION_CULLER_SSE)
+    const char* instructionSet = "SSE, 4 pixels per step";
+#else
+    const char* instructionSet = "no SIMD";
+#endif
+    std::cout << cubeNumber << " cubes, 3 walls, " << instructionSet << std::endl;
+
+    auto projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 200.0f);
+    auto view = glm::lookAt(glm::vec3(0.0f, 1.0f, 10.0f), glm::vec3(0.0f, 0.0f, -50.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    auto reference = run(projection * view, cubes, 1);
+
+    unsigned maxThreadNumber = std::max(2u, std::thread::hardware_concurrency());
+    for (unsigned threadNumber = 2; threadNumber <= maxThreadNumber; threadNumber *= 2)
+    {
+        auto result = run(projection * view, cubes, threadNumber);
+        bool identical = result.depths == reference.depths && result.visible == reference.visible;
+        std::cout << "  same as 1 thread: " << (identical ? "yes" : "no") << std::endl;
+    }
+}
@@ -0,0 +1,105 @@
+#include <benchmark.h>
+#include <program_registry.h>
+
+#include <vector>
+
+//Hosts several scenes in one process, like a viewer showing all the chapters in one window. Every
+//scene asks for the programs of its objects. copy.vs/copy.fs are byte-identical copies of
+//shader.vs/shader.fs, like the shaders copied between the chapters, and tinted.fs is another
+//fragment shader. With a ShaderLoader per object every scene compiles its own programs, the
+//registry builds each distinct pair once and deletes it when the last scene using it is gone.
+//The binary cache is disabled, so both measure the compile and link time.
+
+const int sceneNumber = 8;
+
+struct ShaderPair
+{
+    const char* vertexPath;
+    const char* fragmentPath;
+};
+
+const ShaderPair scenePrograms[] =
+{
+    {"shaders/shader.vs", "shaders/shader.fs"},
+    {"shaders/copy.vs", "shaders/copy.fs"},
+    {"shaders/shader.vs", "shaders/tinted.fs"}
+};
+
+void runLoaders()
+{
+    std::vector<ShaderLoader> shaders;
+    shaders.reserve(sceneNumber * 3);
+    Timer timer;
+    for (int scene = 0; scene < sceneNumber; ++scene)
+    {
+        for (const auto& pair : scenePrograms)
+        {
+            shaders.emplace_back(pair.vertexPath, pair.fragmentPath);
+            shaders.back().setBinaryCacheEnabled(false);
+            shaders.back().linkShaders();
+        }
+    }
+    glFinish();
+    auto time = timer.elapsedMilliseconds();
+
+    std::cout << "ShaderLoader per object" << std::endl;
+    printResult("  programs linked", static_cast<double>(shaders.size()), "");
+    printResult("  load time", time, "ms");
+}
+
+void runRegistry()
+{
+    auto& registry = ProgramRegistry::instance();
+    registry.setBinaryCacheEnabled(false);
+    std::vector<std::vector<ProgramHandle>> scenes(sceneNumber);
+    Timer timer;
+    for (auto& scene : scenes)
+    {
+        for (const auto& pair : scenePrograms)
+            scene.push_back(registry.get(pair.vertexPath, pair.fragmentPath));
+    }
+    glFinish();
+    auto time = timer.elapsedMilliseconds();
+
+    auto stats = registry.getStats();
+    std::cout << "ProgramRegistry" << std::endl;
+    printResult("  programs linked", stats.linked, "");
+    printResult("  requests shared", stats.shared, "");
+    printResult("  load time", time, "ms");
+
+    //Close the scenes one by one, the programs must go away with the last scene using them
+    std::vector<GLuint> programIds;
+    for (const auto& program : scenes[0])
+        programIds.push_back(program->getProgramId());
+    for (auto& scene : scenes)
+        scene.clear();
+    int alive = 0;
+    for (auto id : programIds)
+        alive += glIsProgram(id) ? 1 : 0;
+    printResult("  programs registered after closing the scenes", static_cast<double>(registry.getProgramCount()), "");
+    printResult("  program ids still valid", alive, "");
+}
+
+int main()
+{
+    auto window = initBenchmarkContext();
+    if (window == NULL)
+        return 1;
+
+    try
+    {
+        //Warm up the driver's compiler
+        ShaderLoader warmUp("shaders/shader.vs", "shaders/tinted.fs");
+        warmUp.setBinaryCacheEnabled(false);
+        warmUp.linkShaders();
+
+        runLoaders();
+        runRegistry();
+    }
+    catch (std::string str)
+    {
+        std::cerr << str << std::endl;
+        return 1;
+    }
+    glfwTerminate();
+}
@@ -0,0 +1,12 @@
+#version 330 core
+
+in float vertexTint;
+
+out vec4 FragColor;
+
+uniform sampler2D texture0;
+
+void main()
+{
+    FragColor = texture(texture0, vec2(0.5f)) * (0.25f * VARIANT + vertexTint);
+}
@@ -0,0 +1,29 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProj;
+};
+
+#ifdef DRAW_BLOCK
+layout (std140) uniform Draw
+{
+    mat4 model;
+    float tint;
+};
+#else
+uniform mat4 model;
+uniform float tint;
+#endif
+
+out float vertexTint;
+
+void main()
+{
+    vertexTint = tint;
+    gl_Position = viewProj * model * vec4(aPos, 1.0f);
+}
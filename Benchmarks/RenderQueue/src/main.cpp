@@ -0,0 +1,321 @@
+#include <benchmark.h>
+#include <shader_loader.h>
+#include <camera_uniforms.h>
+#include <gl_state_cache.h>
+#include <mesh_arena.h>
+#include <ring_buffer.h>
+#include <render_queue.h>
+#include <job_system.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+#include <random>
+#include <thread>
+#include <string>
+#include <algorithm>
+#include <cstring>
+
+//Draws a scene of 20000 objects with their own model matrix, mesh, program and texture, once the
+//way renderFrame does it (the OpenGL thread walks the scene, computes each matrix and draws) and
+//once through a RenderQueue, with the packets recorded by 1 to N threads of a JobSystem. The keys
+//are the object indices, so both paths issue the same calls in the same order. Then the queue
+//sorts the packets with the keys of makeDrawSortKey(), and the state changes per frame are
+//compared with the scene order. The frame time includes glFinish; the time of the OpenGL thread
+//is what's left for the driver.
+
+const int objectNumber = 20000;
+const int meshNumber = 8;
+const int programNumber = 4;
+const int textureNumber = 8;
+const int frameNumber = 30;
+const float farPlane = 100.0f;
+
+//The Draw uniform block of shader.vs, padded to the std140 size
+struct DrawBlock
+{
+    glm::mat4 model;
+    float tint;
+    float padding[3];
+};
+
+struct SceneObject
+{
+    glm::vec3 position;
+    glm::vec3 axis;
+    float speed;
+    float tint;
+    int mesh;
+    int program;
+    int texture;
+};
+
+struct Scene
+{
+    std::vector<SceneObject> objects;
+    std::vector<MeshRange> meshes;
+    std::vector<ShaderLoader> directPrograms;
+    std::vector<ShaderLoader> queuePrograms;
+    //Workers don't call OpenGL, so they take the ids from here
+    std::vector<GLuint> queueProgramIds;
+    std::vector<GLuint> textures;
+};
+
+//A sphere-like mesh with 2 * n * n triangles
+void addMesh(MeshArena& arena, int n, std::vector<MeshRange>& meshes)
+{
+    std::vector<GLfloat> vertices;
+    std::vector<GLuint> indices;
+    for (int y = 0; y <= n; ++y)
+    {
+        for (int x = 0; x <= n; ++x)
+        {
+            float theta = 3.14159265f * y / n, phi = 6.2831853f * x / n;
+            vertices.push_back(0.5f * std::sin(theta) * std::cos(phi));
+            vertices.push_back(0.5f * std::cos(theta));
+            vertices.push_back(0.5f * std::sin(theta) * std::sin(phi));
+        }
+    }
+    for (int y = 0; y < n; ++y)
+    {
+        for (int x = 0; x < n; ++x)
+        {
+            GLuint i = static_cast<GLuint>(y * (n + 1) + x);
+            GLuint quad[] = {i, i + 1, i + n + 1, i + 1, i + n + 2, i + n + 1};
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+    MeshRange range;
+    arena.allocate(vertices.data(), vertices.size() / 3, indices.data(), indices.size(), range);
+    meshes.push_back(range);
+}
+
+GLuint makeTexture(int index)
+{
+    unsigned char pixel[] = {static_cast<unsigned char>(64 + 24 * index), 128, static_cast<unsigned char>(255 - 24 * index), 255};
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+glm::mat4 getModel(const SceneObject& object, float time)
+{
+    glm::mat4 model;
+    model = glm::translate(model, object.position);
+    return glm::rotate(model, time * object.speed, object.axis);
+}
+
+double renderDirect(GLFWwindow* window, Scene& scene, GLStateCache& state, GLuint vao)
+{
+    Timer timer;
+    for (int frame = 0; frame < frameNumber; ++frame)
+    {
+        float time = frame / 60.0f;
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        state.bindVertexArray(vao);
+        for (const auto& object : scene.objects)
+        {
+            auto& program = scene.directPrograms[object.program];
+            state.useProgram(program.getProgramId());
+            state.bindTexture(0, GL_TEXTURE_2D, scene.textures[object.texture]);
+            program.setMat4("model", getModel(object, time));
+            program.setFloat("tint", object.tint);
+            const auto& mesh = scene.meshes[object.mesh];
+            glDrawElementsBaseVertex(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT,
+                reinterpret_cast<void*>(mesh.firstIndex * sizeof(GLuint)), mesh.baseVertex);
+        }
+        glfwSwapBuffers(window);
+        glFinish();
+    }
+    return timer.elapsedMilliseconds() / frameNumber;
+}
+
+struct QueueResults
+{
+    double recording, sort, execute, frame;
+    //Of the last frame
+    DrawStateChanges changes;
+    unsigned issuedCalls;
+};
+
+//With stateKeys, the packets are sorted by makeDrawSortKey(), otherwise they stay in scene order
+QueueResults renderQueued(GLFWwindow* window, Scene& scene, GLStateCache& state, GLuint vao, RingBuffer& ring, unsigned threadNumber,
+    bool stateKeys)
+{
+    JobSystem jobs(threadNumber);
+    RenderQueue queue(threadNumber);
+    std::vector<std::uint32_t> textureSets;
+    for (auto texture : scene.textures)
+        textureSets.push_back(queue.addTextureSet(&texture, 1));
+
+    QueueResults results = {0.0, 0.0, 0.0, 0.0, {0, 0, 0}, 0};
+    Timer frameTimer;
+    for (int frame = 0; frame < frameNumber; ++frame)
+    {
+        float time = frame / 60.0f;
+        Timer timer;
+        queue.reset();
+        jobs.parallelFor(0, scene.objects.size(), 256, [&](std::size_t begin, std::size_t end)
+        {
+            auto& commands = queue.getCommandBuffer(jobs.getWorkerIndex());
+            for (auto i = begin; i < end; ++i)
+            {
+                const auto& object = scene.objects[i];
+                DrawPacket packet;
+                packet.program = scene.queueProgramIds[object.program];
+                packet.vertexArray = vao;
+                packet.textureSet = textureSets[object.texture];
+                //The camera looks down -z from the origin
+                packet.key = stateKeys ? makeDrawSortKey(0, packet.program, packet.textureSet, vao, -object.position.z / farPlane) : i;
+                DrawBlock block = {getModel(object, time), object.tint, {0.0f, 0.0f, 0.0f}};
+                std::memcpy(commands.allocateUniforms(sizeof(DrawBlock), packet.uniformOffset), &block, sizeof(DrawBlock));
+                packet.uniformSize = sizeof(DrawBlock);
+                packet.firstInstance = packet.instanceCount = 0;
+                packet.mesh = scene.meshes[object.mesh];
+                commands.draw(packet);
+            }
+        });
+        results.recording += timer.elapsedMilliseconds();
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        state.resetStats();
+        ring.beginFrame(&state);
+        queue.sort(&ring, &jobs);
+        ring.flush(&state);
+        queue.execute(state, ring.getBufferId());
+        ring.endFrame(&state);
+        results.sort += queue.getStats().sortMilliseconds;
+        results.execute += queue.getStats().executeMilliseconds;
+        results.changes = queue.getStats().sortedChanges;
+        results.issuedCalls = state.getStats().issued;
+        glfwSwapBuffers(window);
+        glFinish();
+    }
+    results.frame = frameTimer.elapsedMilliseconds();
+    results.recording /= frameNumber;
+    results.sort /= frameNumber;
+    results.execute /= frameNumber;
+    results.frame /= frameNumber;
+    return results;
+}
+
+void printStateChanges(const QueueResults& results)
+{
+    printResult("    program changes", results.changes.programs, "/frame");
+    printResult("    texture set changes", results.changes.textureSets, "/frame");
+    printResult("    VAO changes", results.changes.vertexArrays, "/frame");
+    printResult("    GLStateCache calls issued", results.issuedCalls, "/frame");
+}
+
+int main()
+{
+    auto window = initBenchmarkContext(128, 128);
+    if (window == NULL)
+        return 1;
+
+    Scene scene;
+    scene.directPrograms.reserve(programNumber);
+    scene.queuePrograms.reserve(programNumber);
+    try
+    {
+        for (int i = 0; i < programNumber; ++i)
+        {
+            scene.directPrograms.push_back(ShaderLoader("shaders/shader.vs", "shaders/shader.fs"));
+            scene.directPrograms.back().addDefine("VARIANT", std::to_string(i));
+            scene.directPrograms.back().linkShaders();
+            scene.queuePrograms.push_back(ShaderLoader("shaders/shader.vs", "shaders/shader.fs"));
+            scene.queuePrograms.back().addDefine("VARIANT", std::to_string(i));
+            scene.queuePrograms.back().addDefine("DRAW_BLOCK");
+            scene.queuePrograms.back().linkShaders();
+            scene.queueProgramIds.push_back(scene.queuePrograms.back().getProgramId());
+        }
+    }
+    catch (std::string str)
+    {
+        std::cerr << str << std::endl;
+        return 1;
+    }
+
+    MeshArena arena(3 * sizeof(GLfloat), 1 << 16, 1 << 18);
+    glBindVertexArray(arena.getVertexArray());
+    glVertexAttribPointer(0, 3, GL_FLOAT, false, 3 * sizeof(GLfloat), (void*)NULL);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+    for (int i = 0; i < meshNumber; ++i)
+        addMesh(arena, 4 + 2 * i, scene.meshes);
+    for (int i = 0; i < textureNumber; ++i)
+        scene.textures.push_back(makeTexture(i));
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> position(-20.0f, 20.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int i = 0; i < objectNumber; ++i)
+    {
+        SceneObject object;
+        object.position = glm::vec3(position(random), position(random), position(random) - 30.0f);
+        object.axis = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.1f));
+        object.speed = 0.5f + unit(random);
+        object.tint = 0.5f + 0.5f * unit(random);
+        object.mesh = static_cast<int>(random() % meshNumber);
+        object.program = static_cast<int>(random() % programNumber);
+        object.texture = static_cast<int>(random() % textureNumber);
+        scene.objects.push_back(object);
+    }
+
+    CameraUniformBuffer camera;
+    camera.update(glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
+        glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, farPlane));
+    glEnable(GL_DEPTH_TEST);
+
+    std::cout << "Renderer: " << reinterpret_cast<const char*>(glGetString(GL_RENDERER)) << std::endl;
+    std::cout << objectNumber << " objects, average of " << frameNumber << " frames" << std::endl;
+    //Each command buffer's uniforms start at an aligned offset, hence the spare blocks
+    RingBuffer ring((objectNumber + 64) * std::max(sizeof(DrawBlock), RingBuffer::getUniformAlignment()), GL_UNIFORM_BUFFER);
+    GLStateCache state;
+
+    renderDirect(window, scene, state, arena.getVertexArray());
+    printResult("direct, OpenGL thread walks the scene", renderDirect(window, scene, state, arena.getVertexArray()), "ms/frame");
+
+    std::vector<unsigned> threadNumbers;
+    unsigned maxThreadNumber = std::max(2u, std::thread::hardware_concurrency());
+    for (unsigned threadNumber = 1; threadNumber < maxThreadNumber; threadNumber *= 2)
+        threadNumbers.push_back(threadNumber);
+    threadNumbers.push_back(maxThreadNumber);
+    {
+        RenderQueue probe(1);
+        std::cout << "render queue, " << (probe.isBaseInstanceUsed() ? "with" : "without") << " base instances" << std::endl;
+    }
+    for (auto threadNumber : threadNumbers)
+    {
+        state.invalidate();
+        auto results = renderQueued(window, scene, state, arena.getVertexArray(), ring, threadNumber, false);
+        std::string name = "  " + std::to_string(threadNumber) + (threadNumber == 1 ? " thread" : " threads");
+        std::cout << name << std::endl;
+        printResult("    recording", results.recording, "ms/frame");
+        printResult("    merge and sort, OpenGL thread", results.sort, "ms/frame");
+        printResult("    execute, OpenGL thread", results.execute, "ms/frame");
+        printResult("    whole frame", results.frame, "ms/frame");
+    }
+
+    for (int stateKeys = 0; stateKeys < 2; ++stateKeys)
+    {
+        state.invalidate();
+        auto results = renderQueued(window, scene, state, arena.getVertexArray(), ring, maxThreadNumber, stateKeys != 0);
+        std::cout << (stateKeys != 0 ? "  sorted by state and depth, " : "  scene order, ") << maxThreadNumber << " threads" << std::endl;
+        printStateChanges(results);
+        printResult("    merge and sort, OpenGL thread", results.sort, "ms/frame");
+        printResult("    execute, OpenGL thread", results.execute, "ms/frame");
+        printResult("    whole frame", results.frame, "ms/frame");
+    }
+    printResult("ring buffer stalls", ring.getStats().stalls, "");
+
+    for (auto texture : scene.textures)
+        glDeleteTextures(1, &texture);
+    glfwTerminate();
+}
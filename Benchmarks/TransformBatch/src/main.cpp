@@ -0,0 +1,100 @@
+#include <benchmark.h>
+#include <transform_batch.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+#include <random>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+//Computes the model matrices of 1M cubes placed and rotated like the ones of the chapters, a
+//third of them spinning, every frame. The glm loop of the chapters (translate, then rotate, one
+//object at a time) is compared with computeTransforms and each kernel this CPU runs, writing
+//mat4 or mat3x4. It doesn't need an OpenGL context.
+
+const std::size_t instanceNumber = 1000000;
+const int frameNumber = 30;
+
+//A 32-byte aligned array, like a mapped buffer, so the kernels can use non-temporal stores
+float* alignOutput(std::vector<float>& storage, std::size_t floatNumber)
+{
+    storage.resize(floatNumber + 8);
+    auto address = reinterpret_cast<std::uintptr_t>(storage.data());
+    return storage.data() + (32 - address % 32) % 32 / sizeof(float);
+}
+
+int main()
+{
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+    std::vector<glm::vec3> positions(instanceNumber), axes(instanceNumber);
+    std::vector<float> baseAngles(instanceNumber), angles(instanceNumber);
+    TransformBatch batch;
+    batch.reserve(instanceNumber);
+    for (std::size_t i = 0; i < instanceNumber; ++i)
+    {
+        positions[i] = glm::vec3(position(random), position(random), position(random));
+        axes[i] = glm::normalize(glm::vec3(direction(random), direction(random), 1.0f));
+        baseAngles[i] = angle(random);
+        batch.add(positions[i], axes[i], baseAngles[i]);
+    }
+    std::cout << instanceNumber << " instances, " << frameNumber << " frames" << std::endl;
+
+    std::vector<glm::mat4> models(instanceNumber);
+    Timer timer;
+    for (int frame = 0; frame < frameNumber; ++frame)
+    {
+        float time = frame / 60.0f;
+        for (std::size_t i = 0; i < instanceNumber; ++i)
+        {
+            angles[i] = i % 3 == 0 ? baseAngles[i] + time : baseAngles[i];
+            models[i] = glm::rotate(glm::translate(glm::mat4(1.0f), positions[i]), angles[i], axes[i]);
+        }
+    }
+    printResult("glm, one at a time", timer.elapsedMilliseconds() / frameNumber, "ms/frame");
+
+    std::vector<float> storage;
+    auto out = alignOutput(storage, instanceNumber * 16);
+    const TransformLayout layouts[] = {TransformLayout::Mat4, TransformLayout::Mat3x4};
+    const TransformKernel kernels[] = {TransformKernel::Scalar, TransformKernel::Sse, TransformKernel::Avx2};
+    for (auto layout : layouts)
+    {
+        for (auto kernel : kernels)
+        {
+            if (!isTransformKernelSupported(kernel))
+                continue;
+            timer.restart();
+            for (int frame = 0; frame < frameNumber; ++frame)
+            {
+                float time = frame / 60.0f;
+                auto batchAngles = batch.getAngles();
+                for (std::size_t i = 0; i < instanceNumber; i += 3)
+                    batchAngles[i] = baseAngles[i] + time;
+                computeTransforms(batch, 0, instanceNumber, out, layout, kernel);
+            }
+            std::string name = std::string(getTransformKernelName(kernel)) + (layout == TransformLayout::Mat4 ? ", mat4" : ", mat3x4");
+            printResult(name.c_str(), timer.elapsedMilliseconds() / frameNumber, "ms/frame");
+
+            //The last frame of both is the same
+            float maxError = 0.0f;
+            for (std::size_t i = 0; i < instanceNumber; ++i)
+            {
+                for (int column = 0; column < 4; ++column)
+                {
+                    for (int row = 0; row < 3; ++row)
+                    {
+                        float value = layout == TransformLayout::Mat4 ? out[i * 16 + column * 4 + row] : out[i * 12 + row * 4 + column];
+                        maxError = std::max(maxError, std::fabs(value - models[i][column][row]));
+                    }
+                }
+            }
+            printResult("  max difference from glm", maxError * 1e6, "x 1e-6");
+        }
+    }
+    std::cout << "Picked at run time: " << getTransformKernelName(getTransformKernel()) << std::endl;
+}
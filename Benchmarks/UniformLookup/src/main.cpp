@@ -0,0 +1,141 @@
+#include <benchmark.h>
+#include <shader_loader.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+//Compares the CPU time of a frame with 10k draws when the location of "model" is queried by
+//glGetUniformLocation for each draw (the way renderFrame used to do it) and when it comes from
+//the table ShaderLoader builds after linking. The last case draws a static scene where every
+//draw uses the same matrix, so ShaderLoader skips all uploads but the first one.
+
+const int drawNumber = 10000;
+const int frameNumber = 100;
+
+void setupVAO(GLuint& vao, GLuint& vbo)
+{
+    GLfloat vertices[] =
+    {
+        -0.01f, -0.01f, 0.0f,
+        0.01f, -0.01f, 0.0f,
+        0.0f, 0.01f, 0.0f
+    };
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, false, 3 * sizeof(GLfloat), (void*)NULL);
+    glEnableVertexAttribArray(0);
+}
+
+glm::mat4 getModel(int i)
+{
+    glm::mat4 model;
+    float x = static_cast<float>(i % 100) / 50.0f - 1.0f;
+    float y = static_cast<float>(i / 100) / 50.0f - 1.0f;
+    return glm::translate(model, glm::vec3(x, y, 0.0f));
+}
+
+double renderFrameWithLookup(ShaderLoader& shader)
+{
+    Timer timer;
+    for (int i = 0; i < drawNumber; ++i)
+    {
+        glm::mat4 model = getModel(i);
+        glUniformMatrix4fv(glGetUniformLocation(shader.getProgramId(), "model"), 1, GL_FALSE, glm::value_ptr(model));
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    return timer.elapsedMilliseconds();
+}
+
+double renderFrameWithSetter(ShaderLoader& shader)
+{
+    Timer timer;
+    for (int i = 0; i < drawNumber; ++i)
+    {
+        shader.setMat4("model", getModel(i));
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    return timer.elapsedMilliseconds();
+}
+
+double renderFrameWithSameValue(ShaderLoader& shader)
+{
+    Timer timer;
+    glm::mat4 model = getModel(0);
+    for (int i = 0; i < drawNumber; ++i)
+    {
+        shader.setMat4("model", model);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    return timer.elapsedMilliseconds();
+}
+
+void printUniformStats(ShaderLoader& shader, double (*renderFunction)(ShaderLoader&))
+{
+    shader.resetUniformStats();
+    renderFunction(shader);
+    auto stats = shader.getUniformStats();
+    printResult("  uploaded", stats.uploaded, "per frame");
+    printResult("  elided", stats.elided, "per frame");
+}
+
+template <typename RenderFunction>
+double measure(GLFWwindow* window, ShaderLoader& shader, RenderFunction renderFunction)
+{
+    //Warm up, the first frames include driver allocations
+    for (int i = 0; i < 5; ++i)
+    {
+        renderFunction(shader);
+        glfwSwapBuffers(window);
+    }
+    glFinish();
+
+    double total = 0.0;
+    for (int i = 0; i < frameNumber; ++i)
+    {
+        glClear(GL_COLOR_BUFFER_BIT);
+        total += renderFunction(shader);
+        glfwSwapBuffers(window);
+    }
+    return total / frameNumber;
+}
+
+int main()
+{
+    auto window = initBenchmarkContext();
+    if (window == NULL)
+        return 1;
+
+    ShaderLoader shader("shaders/shader.vs", "shaders/shader.fs");
+    try
+    {
+        shader.linkShaders();
+    }
+    catch (std::string str)
+    {
+        std::cerr << str << std::endl;
+        return 1;
+    }
+
+    GLuint vao, vbo;
+    setupVAO(vao, vbo);
+    shader.use();
+
+    std::cout << drawNumber << " draws per frame, average of " << frameNumber << " frames" << std::endl;
+    auto lookupTime = measure(window, shader, renderFrameWithLookup);
+    auto setterTime = measure(window, shader, renderFrameWithSetter);
+    auto sameValueTime = measure(window, shader, renderFrameWithSameValue);
+    printResult("glGetUniformLocation per draw", lookupTime, "ms/frame");
+    printResult("ShaderLoader::setMat4", setterTime, "ms/frame");
+    printUniformStats(shader, renderFrameWithSetter);
+    printResult("ShaderLoader::setMat4 with the same value", sameValueTime, "ms/frame");
+    printUniformStats(shader, renderFrameWithSameValue);
+    printResult("Speedup of setMat4", lookupTime / setterTime, "x");
+
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    glfwTerminate();
+}
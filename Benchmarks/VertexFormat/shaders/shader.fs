@@ -0,0 +1,11 @@
+#version 330 core
+
+in vec4 vertexColor;
+in vec2 TexCoord;
+
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = vertexColor * vec4(TexCoord, 1.0f, 1.0f);
+}
@@ -0,0 +1,19 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aColor;
+layout (location = 2) in vec2 aTexCoord;
+
+out vec4 vertexColor;
+out vec2 TexCoord;
+
+//Dequantizes CompactVertex positions, (1, 1, 1) and (0, 0, 0) for float positions
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+void main()
+{
+    gl_Position = vec4(aPos * positionScale + positionOffset, 1.0f);
+    vertexColor = vec4(aColor, 1.0f);
+    TexCoord = aTexCoord;
+}
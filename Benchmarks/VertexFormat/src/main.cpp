@@ -0,0 +1,132 @@
+#include <benchmark.h>
+#include <shader_loader.h>
+#include <vertex_format.h>
+
+#include <vector>
+#include <cmath>
+
+//Measures the vertex throughput of a large mesh stored as FloatVertex (32 bytes, the layout of
+//the chapters) and as CompactVertex (16 bytes). Rasterization is turned off with
+//GL_RASTERIZER_DISCARD and the vertices are drawn as points, so the time is spent fetching and
+//shading vertices, which is where the smaller format helps.
+
+const int gridSize = 1024;
+const int drawsPerFrame = 10;
+const int frameNumber = 20;
+
+std::vector<FloatVertex> makeGrid()
+{
+    std::vector<FloatVertex> vertices(gridSize * gridSize);
+    for (int y = 0; y < gridSize; ++y)
+    {
+        for (int x = 0; x < gridSize; ++x)
+        {
+            float u = static_cast<float>(x) / (gridSize - 1);
+            float v = static_cast<float>(y) / (gridSize - 1);
+            FloatVertex& vertex = vertices[y * gridSize + x];
+            vertex.position[0] = u * 20.0f - 10.0f;
+            vertex.position[1] = v * 20.0f - 10.0f;
+            vertex.position[2] = std::sin(u * 12.0f) * std::cos(v * 12.0f);
+            vertex.color[0] = u;
+            vertex.color[1] = v;
+            vertex.color[2] = 1.0f - u;
+            vertex.texture[0] = u * 4.0f;
+            vertex.texture[1] = v * 4.0f;
+        }
+    }
+    return vertices;
+}
+
+void setupVAO(GLuint& vao, GLuint& vbo, const void* vertices, std::size_t size, const VertexFormat& format)
+{
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
+    format.apply();
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+double measure(GLFWwindow* window, GLuint vao, GLsizei vertexCount)
+{
+    glBindVertexArray(vao);
+    //Warm up
+    glDrawArrays(GL_POINTS, 0, vertexCount);
+    glFinish();
+
+    Timer timer;
+    for (int frame = 0; frame < frameNumber; ++frame)
+    {
+        for (int i = 0; i < drawsPerFrame; ++i)
+            glDrawArrays(GL_POINTS, 0, vertexCount);
+        glfwSwapBuffers(window);
+        glFinish();
+    }
+    return timer.elapsedMilliseconds() / frameNumber;
+}
+
+void printFormat(const char* name, double frameTime, std::size_t vertexSize, GLsizei vertexCount)
+{
+    double vertices = static_cast<double>(vertexCount) * drawsPerFrame;
+    std::cout << name << std::endl;
+    printResult("  vertex size", static_cast<double>(vertexSize), "bytes");
+    printResult("  frame time", frameTime, "ms/frame");
+    printResult("  throughput", vertices / frameTime / 1000.0, "Mvertices/s");
+    printResult("  vertex data read", vertices * vertexSize / frameTime / 1000000.0, "GB/s");
+}
+
+int main()
+{
+    auto window = initBenchmarkContext();
+    if (window == NULL)
+        return 1;
+
+    ShaderLoader shader("shaders/shader.vs", "shaders/shader.fs");
+    try
+    {
+        shader.linkShaders();
+    }
+    catch (std::string str)
+    {
+        std::cerr << str << std::endl;
+        return 1;
+    }
+
+    auto floatVertices = makeGrid();
+    auto compactMesh = compactVertices(floatVertices.data(), floatVertices.size());
+    auto vertexCount = static_cast<GLsizei>(floatVertices.size());
+
+    GLuint floatVao, floatVbo, compactVao, compactVbo;
+    setupVAO(floatVao, floatVbo, floatVertices.data(), floatVertices.size() * sizeof(FloatVertex), getFloatVertexFormat());
+    setupVAO(compactVao, compactVbo, compactMesh.vertices.data(), compactMesh.vertices.size() * sizeof(CompactVertex),
+        getCompactVertexFormat());
+
+    shader.use();
+    glEnable(GL_RASTERIZER_DISCARD);
+    auto scaleLocation = shader.getUniformLocation("positionScale");
+    auto offsetLocation = shader.getUniformLocation("positionOffset");
+
+    const GLfloat one[] = {1.0f, 1.0f, 1.0f}, zero[] = {0.0f, 0.0f, 0.0f};
+    glUniform3fv(scaleLocation, 1, one);
+    glUniform3fv(offsetLocation, 1, zero);
+    auto floatTime = measure(window, floatVao, vertexCount);
+
+    glUniform3fv(scaleLocation, 1, compactMesh.positionScale);
+    glUniform3fv(offsetLocation, 1, compactMesh.positionOffset);
+    auto compactTime = measure(window, compactVao, vertexCount);
+
+    std::cout << vertexCount << " vertices, " << drawsPerFrame << " draws per frame, average of "
+              << frameNumber << " frames" << std::endl;
+    printFormat("FloatVertex (float position, color and uv)", floatTime, sizeof(FloatVertex), vertexCount);
+    printFormat("CompactVertex (snorm16 position, rgba8 color, half uv)", compactTime, sizeof(CompactVertex), vertexCount);
+    printResult("Speedup", floatTime / compactTime, "x");
+
+    glDisable(GL_RASTERIZER_DISCARD);
+    glDeleteVertexArrays(1, &floatVao);
+    glDeleteBuffers(1, &floatVbo);
+    glDeleteVertexArrays(1, &compactVao);
+    glDeleteBuffers(1, &compactVbo);
+    glfwTerminate();
+}
@@ -0,0 +1,76 @@
+#include <benchmark.h>
+#include <vertex_weld.h>
+
+#include <vector>
+
+//Welds the triangle soup of grids from 130 thousand to 17 million triangles, i.e. 6 corners per
+//quad where every inner vertex appears 6 times. The time per corner should stay about the
+//same from the smallest to the largest grid, since the welding is linear. It doesn't need an
+//OpenGL context.
+
+struct Vertex
+{
+    GLfloat position[3];
+    GLfloat texture[2];
+};
+
+const int gridSizes[] = {256, 724, 2048, 2896};
+
+std::vector<Vertex> makeGridSoup(int n)
+{
+    std::vector<Vertex> soup;
+    soup.reserve(static_cast<std::size_t>(n - 1) * (n - 1) * 6);
+    auto makeVertex = [n](int x, int y)
+    {
+        Vertex vertex =
+        {
+            {static_cast<GLfloat>(x), static_cast<GLfloat>(y), 0.0f},
+            {static_cast<GLfloat>(x) / (n - 1), static_cast<GLfloat>(y) / (n - 1)}
+        };
+        return vertex;
+    };
+    for (int y = 0; y + 1 < n; ++y)
+    {
+        for (int x = 0; x + 1 < n; ++x)
+        {
+            soup.push_back(makeVertex(x, y));
+            soup.push_back(makeVertex(x + 1, y));
+            soup.push_back(makeVertex(x, y + 1));
+            soup.push_back(makeVertex(x + 1, y));
+            soup.push_back(makeVertex(x + 1, y + 1));
+            soup.push_back(makeVertex(x, y + 1));
+        }
+    }
+    return soup;
+}
+
+int main()
+{
+    for (int n : gridSizes)
+    {
+        std::vector<Vertex> vertices;
+        std::vector<GLuint> indices;
+        double time;
+        std::size_t cornerCount;
+        {
+            auto soup = makeGridSoup(n);
+            cornerCount = soup.size();
+            Timer timer;
+            weldVertices(soup.data(), soup.size(), vertices, indices);
+            time = timer.elapsedMilliseconds();
+        }
+        if (vertices.size() != static_cast<std::size_t>(n) * n)
+        {
+            std::cerr << "Expected " << n * n << " unique vertices, got " << vertices.size() << std::endl;
+            return 1;
+        }
+
+        std::cout << n << "x" << n << " grid, " << cornerCount / 3 << " triangles" << std::endl;
+        printResult("  unique vertices", static_cast<double>(vertices.size()), "");
+        printResult("  weld time", time, "ms");
+        printResult("  time per corner", time * 1000000.0 / cornerCount, "ns");
+        printResult("  soup size", cornerCount * sizeof(Vertex) / 1048576.0, "MB");
+        printResult("  vertex and index buffer size",
+            (vertices.size() * sizeof(Vertex) + indices.size() * sizeof(GLuint)) / 1048576.0, "MB");
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <opengl_loader.h>
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+//Creates an invisible window with a 3.3 core context and loads OpenGL. The benchmarks don't
+//need to show anything, so they also run on a virtual display (e.g. xvfb-run with llvmpipe).
+GLFWwindow* initBenchmarkContext(int width = 64, int height = 64)
+{
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); //Fixing compilation on OS X
+#endif
+
+    GLFWwindow* window = glfwCreateWindow(width, height, "Benchmark", NULL, NULL);
+    if (window == NULL)
+    {
+        std::cerr << "Cannot create a GLFW window" << std::endl;
+        glfwTerminate();
+        return NULL;
+    }
+    glfwMakeContextCurrent(window);
+    //Don't let vsync limit the frame rate
+    glfwSwapInterval(0);
+    if (!loadOpenGL())
+    {
+        std::cerr << "Failed to load OpenGL" << std::endl;
+        glfwTerminate();
+        return NULL;
+    }
+    return window;
+}
+
+class Timer
+{
+public:
+    Timer() :
+        start{std::chrono::steady_clock::now()}
+    {
+    }
+
+    void restart()
+    {
+        start = std::chrono::steady_clock::now();
+    }
+
+    double elapsedMilliseconds() const
+    {
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+void printResult(const char* name, double value, const char* unit)
+{
+    std::cout << std::left << std::setw(48) << name << std::right << std::setw(14)
+              << std::fixed << std::setprecision(4) << value << " " << unit << std::endl;
+}
+
+#endif
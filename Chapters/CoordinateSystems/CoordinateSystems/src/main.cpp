@@ -8,6 +8,9 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <shader_loader.h>
+#include <gl_state_cache.h>
+#include <mapped_file.h>
+#include <camera_uniforms.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -23,6 +26,9 @@ struct MyImage
     GLenum pixelFormat;
 };
 
+//Skips the binds which are already in effect from the last frame
+static GLStateCache glState;
+
 const bool enableWireframeMode = false;
 
 GLFWwindow* initGLFW()
@@ -131,7 +137,10 @@ bool setupTexture(GLuint* texture, int texNum, MyImage* image)
         int width, height, channelNumber;
         // tell stb_image.h to flip loaded texture's on the y-axis.
         stbi_set_flip_vertically_on_load(true);
-        auto data = stbi_load(image[i].path, &width, &height, &channelNumber, 0);
+        //Decode straight from the mapped file instead of reading it through stdio
+        MappedFile file(image[i].path);
+        auto data = file.isOpen() ? stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.getData()),
+            static_cast<int>(file.getSize()), &width, &height, &channelNumber, 0) : NULL;
         if (data == NULL)
         {
             std::cerr << "Cannot load " << image[i].path << std::endl;
@@ -144,17 +153,16 @@ bool setupTexture(GLuint* texture, int texNum, MyImage* image)
     return true;
 }
 
-void renderFrame(ShaderLoader& shader, GLuint vao, GLuint* texture, int texNum)
+void renderFrame(ShaderLoader& shader, CameraUniformBuffer& camera, GLuint vao, GLuint* texture, int texNum)
 {
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    shader.use();
+    glState.useProgram(shader.getProgramId());
     for (int i = 0; i < texNum; ++i)
     {
         // bind textures on corresponding texture units
-        glActiveTexture(static_cast<GLenum>(static_cast<int>(GL_TEXTURE0) + i));
-        glBindTexture(GL_TEXTURE_2D, texture[i]);
+        glState.bindTexture(i, GL_TEXTURE_2D, texture[i]);
     }
 
     //We should reset the model matrix because it's a global variable!
@@ -162,9 +170,9 @@ void renderFrame(ShaderLoader& shader, GLuint vao, GLuint* texture, int texNum)
     model = glm::rotate(model, glm::radians(-55.0f), glm::vec3(1.0f, 0.0f, 0.0f));
     view = glm::mat4();
     view = glm::translate(view, glm::vec3(0.0f, 0.0f, -3.0f));
-    glUniformMatrix4fv(glGetUniformLocation(shader.getProgramId(), "model"), 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(glGetUniformLocation(shader.getProgramId(), "view"), 1, GL_FALSE, glm::value_ptr(view));
-	glBindVertexArray(vao);
+    shader.setMat4("model", model);
+    camera.update(view, projection, &glState);
+	glState.bindVertexArray(vao);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL);
 }
 
@@ -197,6 +205,8 @@ int main()
         std::cerr << str << std::endl;
         return 1;
     }
+    //Binds the buffer to the Camera block of the shaders
+    CameraUniformBuffer camera;
 
     GLuint texture[2];
     //Note that the png file has alpha channel!
@@ -215,18 +225,17 @@ int main()
 	if (enableWireframeMode)
 		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-    shader.use();
+    shader.use(glState);
     //tell opengl for each sampler to which texture unit it belongs to (only has to be done once)
-    //We can use glUniform1i after shader.use
-    glUniform1i(glGetUniformLocation(shader.getProgramId(), "ourTexture1"), 0);
-    glUniform1i(glGetUniformLocation(shader.getProgramId(), "ourTexture2"), 1);
+    //We can use the setters after shader.use
+    shader.setInt("ourTexture1", 0);
+    shader.setInt("ourTexture2", 1);
 
     projection = glm::perspective(glm::radians(45.0f), static_cast<float>(WIDTH) / HEIGHT, 0.1f, 100.0f);
-    glUniformMatrix4fv(glGetUniformLocation(shader.getProgramId(), "projection"), 1, GL_FALSE, glm::value_ptr(projection));
     while (!glfwWindowShouldClose(window))
     {
         processInput(window);
-        renderFrame(shader, vao, texture, 2);
+        renderFrame(shader, camera, vao, texture, 2);
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
@@ -8,6 +8,10 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <shader_loader.h>
+#include <gl_state_cache.h>
+#include <mapped_file.h>
+#include <camera_uniforms.h>
+#include <vertex_weld.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -24,6 +28,9 @@ struct MyImage
     GLenum pixelFormat;
 };
 
+//Skips the binds which are already in effect from the last frame
+static GLStateCache glState;
+
 const bool enableWireframeMode = false;
 
 GLFWwindow* initGLFW()
@@ -88,89 +95,71 @@ void setupVAO(GLuint& vao, GLuint& vbo, GLuint& ebo)
     //
     //Note that a cube is a bit of a worst-case example as most complex models usually do share quite
     //a few vertices among triangles.
-    Vertex vertices[6][4] =
-	{
+    //The corners of the 12 triangles, clockwise. For each face we have:
+    //(top right, bottom right, top left), (bottom right, bottom left, top left)
+    Vertex corners[6][6] =
+    {
         //Front face
         {
-            {{0.5f, 0.5f, 0.5f}, {0.0f, 0.0f, 0.0f}, {1.0f, 1.0f}},     //top right
+            {{0.5f, 0.5f, 0.5f}, {0.0f, 0.0f, 0.0f}, {1.0f, 1.0f}},    //top right
             {{0.5f, -0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f}},    //bottom right
-            {{-0.5f, -0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},   //bottom left
+            {{-0.5f, 0.5f, 0.5f}, {0.0f, 1.0f, 1.0f}, {0.0f, 1.0f}},    //top left
+            {{0.5f, -0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f}},    //bottom right
+            {{-0.5f, -0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},    //bottom left
             {{-0.5f, 0.5f, 0.5f}, {0.0f, 1.0f, 1.0f}, {0.0f, 1.0f}}     //top left
         },
         //back face
         {
-            {{0.5f, 0.5f, -0.5f}, {0.0f, 0.0f, 0.0f}, {1.0f, 1.0f}},     //top right
+            {{0.5f, 0.5f, -0.5f}, {0.0f, 0.0f, 0.0f}, {1.0f, 1.0f}},    //top right
+            {{0.5f, -0.5f, -0.5f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f}},    //bottom right
+            {{-0.5f, 0.5f, -0.5f}, {0.0f, 1.0f, 1.0f}, {0.0f, 1.0f}},    //top left
             {{0.5f, -0.5f, -0.5f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f}},    //bottom right
-            {{-0.5f, -0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},   //bottom left
+            {{-0.5f, -0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},    //bottom left
             {{-0.5f, 0.5f, -0.5f}, {0.0f, 1.0f, 1.0f}, {0.0f, 1.0f}}     //top left
         },
         //right face
         {
-            {{0.5f, 0.5f, -0.5f}, {0.0f, 0.0f, 0.0f}, {1.0f, 1.0f}},     //top right
+            {{0.5f, 0.5f, -0.5f}, {0.0f, 0.0f, 0.0f}, {1.0f, 1.0f}},    //top right
             {{0.5f, -0.5f, -0.5f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f}},    //bottom right
-            {{0.5f, -0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},   //bottom left
+            {{0.5f, 0.5f, 0.5f}, {0.0f, 1.0f, 1.0f}, {0.0f, 1.0f}},    //top left
+            {{0.5f, -0.5f, -0.5f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f}},    //bottom right
+            {{0.5f, -0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},    //bottom left
             {{0.5f, 0.5f, 0.5f}, {0.0f, 1.0f, 1.0f}, {0.0f, 1.0f}}     //top left
         },
         //Left face
         {
-            {{-0.5f, 0.5f, 0.5f}, {0.0f, 0.0f, 0.0f}, {1.0f, 1.0f}},     //top right
+            {{-0.5f, 0.5f, 0.5f}, {0.0f, 0.0f, 0.0f}, {1.0f, 1.0f}},    //top right
+            {{-0.5f, -0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f}},    //bottom right
+            {{-0.5f, 0.5f, -0.5f}, {1.0f, 1.0f, 1.0f}, {0.0f, 1.0f}},    //top left
             {{-0.5f, -0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f}},    //bottom right
-            {{-0.5f, -0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},   //bottom left
+            {{-0.5f, -0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},    //bottom left
             {{-0.5f, 0.5f, -0.5f}, {1.0f, 1.0f, 1.0f}, {0.0f, 1.0f}}     //top left
         },
         //Top face
         {
-            {{0.5f, 0.5f, -0.5f}, {0.0f, 0.0f, 0.0f}, {1.0f, 1.0f}},     //top right
+            {{0.5f, 0.5f, -0.5f}, {0.0f, 0.0f, 0.0f}, {1.0f, 1.0f}},    //top right
             {{0.5f, 0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f}},    //bottom right
-            {{-0.5f, 0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},   //bottom left
+            {{-0.5f, 0.5f, -0.5f}, {0.0f, 1.0f, 1.0f}, {0.0f, 1.0f}},    //top left
+            {{0.5f, 0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f}},    //bottom right
+            {{-0.5f, 0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},    //bottom left
             {{-0.5f, 0.5f, -0.5f}, {0.0f, 1.0f, 1.0f}, {0.0f, 1.0f}}     //top left
         },
         //Bottom face
         {
-            {{0.5f, -0.5f, 0.5f}, {0.0f, 0.0f, 0.0f}, {1.0f, 1.0f}},     //top right
+            {{0.5f, -0.5f, 0.5f}, {0.0f, 0.0f, 0.0f}, {1.0f, 1.0f}},    //top right
+            {{0.5f, -0.5f, -0.5f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f}},    //bottom right
+            {{-0.5f, -0.5f, 0.5f}, {0.0f, 1.0f, 1.0f}, {0.0f, 1.0f}},    //top left
             {{0.5f, -0.5f, -0.5f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f}},    //bottom right
-            {{-0.5f, -0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},   //bottom left
+            {{-0.5f, -0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},    //bottom left
             {{-0.5f, -0.5f, 0.5f}, {0.0f, 1.0f, 1.0f}, {0.0f, 1.0f}}     //top left
         }
-	};    
-
-    //Don't forget to tell glDrawElements we have 36 vertices
-    //The indices are clockwise. For each face we have:
-    //(top right, bottom right, top left), (bottom right, bottom left, top left)
-    GLuint indices[6][2][3] =
-    {
-        //Front face
-        {
-            {0, 1, 3},
-            {1, 2, 3}
-        },
-        //Back face
-        {
-            {4, 5, 7},
-            {5, 6, 7}
-        },
-        //Right face
-        {
-            {8, 9, 11},
-            {9, 10, 11}
-        },
-        //Left face
-        {
-            {12, 13, 15},
-            {13, 14, 15}
-        },
-        //Top face
-        {
-            {16, 17, 19},
-            {17, 18, 19}
-        },
-        //Bottom face
-        {
-            {20, 21, 23},
-            {21, 22, 23}
-        }
     };
 
+    //Shares the corners which are the same in every attribute
+    std::vector<Vertex> vertices;
+    std::vector<GLuint> indices;
+    weldVertices(&corners[0][0], 36, vertices, indices);
+
 	glGenVertexArrays(1, &vao);
 
 	glGenBuffers(1, &vbo);
@@ -180,10 +169,10 @@ void setupVAO(GLuint& vao, GLuint& vbo, GLuint& ebo)
 	glBindVertexArray(vao);
 
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
 
     glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(Vertex), (void*)NULL);
     glEnableVertexAttribArray(0);
@@ -219,7 +208,10 @@ bool setupTexture(GLuint* texture, int texNum, MyImage* image)
         int width, height, channelNumber;
         // tell stb_image.h to flip loaded texture's on the y-axis.
         stbi_set_flip_vertically_on_load(true);
-        auto data = stbi_load(image[i].path, &width, &height, &channelNumber, 0);
+        //Decode straight from the mapped file instead of reading it through stdio
+        MappedFile file(image[i].path);
+        auto data = file.isOpen() ? stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.getData()),
+            static_cast<int>(file.getSize()), &width, &height, &channelNumber, 0) : NULL;
         if (data == NULL)
         {
             std::cerr << "Cannot load " << image[i].path << std::endl;
@@ -232,7 +224,7 @@ bool setupTexture(GLuint* texture, int texNum, MyImage* image)
     return true;
 }
 
-void renderFrame(ShaderLoader& shader, GLuint vao, GLuint* texture, int texNum)
+void renderFrame(ShaderLoader& shader, CameraUniformBuffer& camera, GLuint vao, GLuint* texture, int texNum)
 {
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
 #ifdef ENABLE_DEPTH_TEST
@@ -240,12 +232,11 @@ void renderFrame(ShaderLoader& shader, GLuint vao, GLuint* texture, int texNum)
 #else
 	glClear(GL_COLOR_BUFFER_BIT);
 #endif // ENABLE_DEPTH_TEST    
-    shader.use();
+    glState.useProgram(shader.getProgramId());
     for (int i = 0; i < texNum; ++i)
     {
         // bind textures on corresponding texture units
-        glActiveTexture(static_cast<GLenum>(static_cast<int>(GL_TEXTURE0) + i));
-        glBindTexture(GL_TEXTURE_2D, texture[i]);
+        glState.bindTexture(i, GL_TEXTURE_2D, texture[i]);
     }
 
     //We should reset the model matrix because it's a global variable!
@@ -253,9 +244,9 @@ void renderFrame(ShaderLoader& shader, GLuint vao, GLuint* texture, int texNum)
     model = glm::rotate(model, static_cast<float>(glfwGetTime()) * glm::radians(50.0f), glm::vec3(0.5f, 1.0f, 0.0f));
     view = glm::mat4();
     view = glm::translate(view, glm::vec3(0.0f, 0.0f, -3.0f));
-    glUniformMatrix4fv(glGetUniformLocation(shader.getProgramId(), "model"), 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(glGetUniformLocation(shader.getProgramId(), "view"), 1, GL_FALSE, glm::value_ptr(view));
-	glBindVertexArray(vao);
+    shader.setMat4("model", model);
+    camera.update(view, projection, &glState);
+	glState.bindVertexArray(vao);
     glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, NULL);
 }
 
@@ -288,6 +279,8 @@ int main()
         std::cerr << str << std::endl;
         return 1;
     }
+    //Binds the buffer to the Camera block of the shaders
+    CameraUniformBuffer camera;
 
     GLuint texture[2];
     //Note that the png file has alpha channel!
@@ -306,24 +299,23 @@ int main()
 	if (enableWireframeMode)
 		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-    shader.use();
+    shader.use(glState);
     //tell opengl for each sampler to which texture unit it belongs to (only has to be done once)
-    //We can use glUniform1i after shader.use
-    glUniform1i(glGetUniformLocation(shader.getProgramId(), "ourTexture1"), 0);
-    glUniform1i(glGetUniformLocation(shader.getProgramId(), "ourTexture2"), 1);
+    //We can use the setters after shader.use
+    shader.setInt("ourTexture1", 0);
+    shader.setInt("ourTexture2", 1);
 
     projection = glm::perspective(glm::radians(45.0f), static_cast<float>(WIDTH) / HEIGHT, 0.1f, 100.0f);
     //In model matrix we translate objects by (0, 0, -3), so we have:
     //projection = glm::ortho(-1.0f, 1.0f, -1.0f, 1.0f, -3.5f, 2.5f);
-    glUniformMatrix4fv(glGetUniformLocation(shader.getProgramId(), "projection"), 1, GL_FALSE, glm::value_ptr(projection));
 #ifdef ENABLE_DEPTH_TEST
-	glEnable(GL_DEPTH_TEST);
+	glState.enable(GL_DEPTH_TEST);
 #endif // ENABLE_DEPTH_TEST
 
     while (!glfwWindowShouldClose(window))
     {
         processInput(window);
-        renderFrame(shader, vao, texture, 2);
+        renderFrame(shader, camera, vao, texture, 2);
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
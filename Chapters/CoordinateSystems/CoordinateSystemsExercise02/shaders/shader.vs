@@ -7,13 +7,19 @@ layout (location = 2) in vec2 aTexCoord;
 out vec4 vertexColor;
 out vec2 TexCoord;
 
+//Shared by all programs, see CameraUniformBuffer
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProj;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0f);
+    gl_Position = viewProj * model * vec4(aPos, 1.0f);
     vertexColor = vec4(aColor, 1.0f);
     TexCoord = aTexCoord;
 }
\ No newline at end of file
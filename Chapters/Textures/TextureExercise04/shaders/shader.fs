@@ -7,9 +7,13 @@ out vec4 FragColor;
 
 uniform sampler2D ourTexture1;
 uniform sampler2D ourTexture2;
-uniform float alpha;
+
+//Each value of MIX_FACTOR is a separate variant of the program (see ShaderVariantCache::prefetch())
+#ifndef MIX_FACTOR
+#define MIX_FACTOR 0.2
+#endif
 
 void main()
 {
-    FragColor = mix(texture(ourTexture1, TexCoord), texture(ourTexture2, TexCoord), alpha);
+    FragColor = mix(texture(ourTexture1, TexCoord), texture(ourTexture2, TexCoord), MIX_FACTOR);
 } 
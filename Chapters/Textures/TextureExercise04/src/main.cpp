@@ -3,8 +3,13 @@
 #include <iostream>
 #include <cmath>
 #include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <vector>
 
-#include <shader_loader.h>
+#include <shader_variants.h>
+#include <gl_state_cache.h>
+#include <mapped_file.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -14,6 +19,7 @@
 
 float alpha = 0.2f;
 const float speed = 0.5f;
+const int alphaSteps = 20;
 double prevTime = 0.0;
 double curTime;
 
@@ -23,6 +29,9 @@ struct MyImage
     GLenum pixelFormat;
 };
 
+//Skips the binds which are already in effect from the last frame
+static GLStateCache glState;
+
 const bool enableWireframeMode = false;
 
 GLFWwindow* initGLFW()
@@ -148,7 +157,10 @@ bool setupTexture(GLuint* texture, int texNum, MyImage* image)
         int width, height, channelNumber;
         // tell stb_image.h to flip loaded texture's on the y-axis.
         stbi_set_flip_vertically_on_load(true);
-        auto data = stbi_load(image[i].path, &width, &height, &channelNumber, 0);
+        //Decode straight from the mapped file instead of reading it through stdio
+        MappedFile file(image[i].path);
+        auto data = file.isOpen() ? stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.getData()),
+            static_cast<int>(file.getSize()), &width, &height, &channelNumber, 0) : NULL;
         if (data == NULL)
         {
             std::cerr << "Cannot load " << image[i].path << std::endl;
@@ -161,20 +173,45 @@ bool setupTexture(GLuint* texture, int texNum, MyImage* image)
     return true;
 }
 
-void renderFrame(ShaderLoader& shader, GLuint vao, GLuint* texture, int texNum, GLint alphauniform)
+//Instead of uploading alpha to a uniform, alpha is rounded to one of alphaSteps values and each
+//value is a variant of the program with a constant mix factor. All the variants are built up
+//front in one batch, so changing alpha never compiles a program in the middle of a frame.
+void buildShaders(ShaderVariantCache& variants, std::vector<ShaderLoader*>& shaders)
+{
+    ShaderBatch batch;
+    for (int step = 0; step <= alphaSteps; ++step)
+    {
+        std::ostringstream mixFactor;
+        mixFactor << std::fixed << std::setprecision(2) << static_cast<float>(step) / alphaSteps;
+        shaders.push_back(&variants.prefetch("shaders/shader.vs", "shaders/shader.fs", batch, {{"MIX_FACTOR", mixFactor.str()}}));
+    }
+    batch.finishAll();
+    for (auto shader : shaders)
+    {
+        glState.useProgram(shader->getProgramId());
+        //tell opengl for each sampler to which texture unit it belongs to
+        shader->setInt("ourTexture1", 0);
+        shader->setInt("ourTexture2", 1);
+    }
+}
+
+ShaderLoader& getShader(const std::vector<ShaderLoader*>& shaders)
+{
+    return *shaders[std::lround(alpha * alphaSteps)];
+}
+
+void renderFrame(ShaderLoader& shader, GLuint vao, GLuint* texture, int texNum)
 {
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    shader.use();
-    glUniform1f(alphauniform, alpha);
+    glState.useProgram(shader.getProgramId());
     for (int i = 0; i < texNum; ++i)
     {
         // bind textures on corresponding texture units
-        glActiveTexture(static_cast<GLenum>(static_cast<int>(GL_TEXTURE0) + i));
-        glBindTexture(GL_TEXTURE_2D, texture[i]);
+        glState.bindTexture(i, GL_TEXTURE_2D, texture[i]);
     }
-	glBindVertexArray(vao);
+	glState.bindVertexArray(vao);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL);
 }
 
@@ -197,10 +234,11 @@ int main()
         return 1;
     }
 
-    ShaderLoader shader("shaders/shader.vs", "shaders/shader.fs");
+    ShaderVariantCache variants;
+    std::vector<ShaderLoader*> shaders;
     try
     {
-        shader.linkShaders();
+        buildShaders(variants, shaders);
     }
     catch (std::string str)
     {
@@ -225,18 +263,11 @@ int main()
 	if (enableWireframeMode)
 		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-    shader.use();
-    //tell opengl for each sampler to which texture unit it belongs to (only has to be done once)
-    //We can use glUniform1i after shader.use
-    glUniform1i(glGetUniformLocation(shader.getProgramId(), "ourTexture1"), 0);
-    glUniform1i(glGetUniformLocation(shader.getProgramId(), "ourTexture2"), 1);
-
-    auto alphaUnifrom = glGetUniformLocation(shader.getProgramId(), "alpha");
     while (!glfwWindowShouldClose(window))
     {
         curTime = glfwGetTime();
         processInput(window);
-        renderFrame(shader, vao, texture, 2, alphaUnifrom);
+        renderFrame(getShader(shaders), vao, texture, 2);
         glfwSwapBuffers(window);
         glfwPollEvents();
         prevTime = curTime;
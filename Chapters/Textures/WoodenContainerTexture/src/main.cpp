@@ -4,6 +4,8 @@
 #include <cmath>
 
 #include <shader_loader.h>
+#include <gl_state_cache.h>
+#include <mapped_file.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -11,6 +13,9 @@
 #define WIDTH 800
 #define HEIGHT 600
 
+//Skips the binds which are already in effect from the last frame
+static GLStateCache glState;
+
 const bool enableWireframeMode = false;
 
 GLFWwindow* initGLFW()
@@ -117,7 +122,10 @@ bool setupTexture(GLuint texture)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
     int width, height, channelNumber;
-    auto data = stbi_load("shaders/container.jpg", &width, &height, &channelNumber, 0);
+    //Decode straight from the mapped file instead of reading it through stdio
+    MappedFile file("shaders/container.jpg");
+    auto data = file.isOpen() ? stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.getData()),
+        static_cast<int>(file.getSize()), &width, &height, &channelNumber, 0) : NULL;
 
     if (data == NULL)
     {
@@ -136,9 +144,9 @@ void renderFrame(ShaderLoader& shader, GLuint vao, GLuint texture)
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    shader.use();
-    glBindTexture(GL_TEXTURE_2D, texture);
-	glBindVertexArray(vao);
+    glState.useProgram(shader.getProgramId());
+    glState.bindTexture(0, GL_TEXTURE_2D, texture);
+	glState.bindVertexArray(vao);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL);
 }
 
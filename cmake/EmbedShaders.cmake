@@ -0,0 +1,29 @@
+# Provides embed_shaders(target shader_dir)
+#
+# Turns the *.vs and *.fs files of shader_dir into constexpr strings in a generated
+# embedded_shaders.h and defines EMBED_SHADERS for the target. ShaderLoader then takes the
+# embedded copy of "shaders/<file name>" instead of reading the file at run time.
+# It does nothing if EMBED_SHADERS option is OFF, so we can edit the shaders without a rebuild.
+
+set(EMBED_SHADERS_SCRIPT "${CMAKE_CURRENT_LIST_DIR}/GenerateShaderHeader.cmake")
+
+function(embed_shaders target shader_dir)
+    if (NOT EMBED_SHADERS)
+        return()
+    endif ()
+
+    file(GLOB shader_files "${shader_dir}/*.vs" "${shader_dir}/*.fs")
+    if (NOT shader_files)
+        return()
+    endif ()
+
+    set(output_dir "${CMAKE_CURRENT_BINARY_DIR}/generated")
+    set(output "${output_dir}/embedded_shaders.h")
+    add_custom_command(OUTPUT "${output}"
+        COMMAND "${CMAKE_COMMAND}" "-DSHADER_DIR=${shader_dir}" "-DOUTPUT=${output}" -P "${EMBED_SHADERS_SCRIPT}"
+        DEPENDS ${shader_files} "${EMBED_SHADERS_SCRIPT}"
+        COMMENT "Embedding shaders of ${target}")
+    target_sources(${target} PRIVATE "${output}")
+    target_include_directories(${target} PRIVATE "${output_dir}")
+    target_compile_definitions(${target} PRIVATE EMBED_SHADERS)
+endfunction()
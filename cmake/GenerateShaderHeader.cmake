@@ -0,0 +1,20 @@
+# Script mode helper of embed_shaders(). Usage:
+# cmake -DSHADER_DIR=<dir> -DOUTPUT=<header> -P GenerateShaderHeader.cmake
+
+file(GLOB shader_files "${SHADER_DIR}/*.vs" "${SHADER_DIR}/*.fs")
+list(SORT shader_files)
+
+set(content "//Generated from ${SHADER_DIR} by GenerateShaderHeader.cmake. Don't edit it.\n\n")
+set(content "${content}#ifndef EMBEDDED_SHADERS_H\n#define EMBEDDED_SHADERS_H\n\n")
+# It is included by shader_source.h, which defines ShaderSource and EmbeddedShader
+set(table "")
+foreach (shader_file ${shader_files})
+    get_filename_component(name "${shader_file}" NAME)
+    string(MAKE_C_IDENTIFIER "${name}" identifier)
+    file(READ "${shader_file}" source)
+    set(content "${content}constexpr char embedded_${identifier}[] = R\"glsl(${source})glsl\";\n\n")
+    set(table "${table}    {\"shaders/${name}\", ShaderSource(embedded_${identifier})},\n")
+endforeach ()
+set(content "${content}constexpr EmbeddedShader embeddedShaders[] =\n{\n${table}};\n\n#endif\n")
+
+file(WRITE "${OUTPUT}" "${content}")
@@ -0,0 +1,484 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <frustum_culling.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <thread>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+struct Aabb
+{
+    float min[3];
+    float max[3];
+};
+
+inline Aabb makeEmptyAabb()
+{
+    const float infinity = std::numeric_limits<float>::infinity();
+    Aabb box = {{infinity, infinity, infinity}, {-infinity, -infinity, -infinity}};
+    return box;
+}
+
+inline void growAabb(Aabb& box, const Aabb& other)
+{
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        box.min[axis] = std::min(box.min[axis], other.min[axis]);
+        box.max[axis] = std::max(box.max[axis], other.max[axis]);
+    }
+}
+
+//Half of the surface area, which is all the SAH needs
+inline float getHalfArea(const Aabb& box)
+{
+    float size[3];
+    for (int axis = 0; axis < 3; ++axis)
+        size[axis] = std::max(0.0f, box.max[axis] - box.min[axis]);
+    return size[0] * size[1] + size[1] * size[2] + size[2] * size[0];
+}
+
+//32 bytes, two nodes per cache line. The nodes are stored depth-first, so the first child of an
+//inner node is the next node and only the second child needs an index.
+struct BvhNode
+{
+    Aabb bounds;
+    //Inner nodes: the index of the second child. Leaves: the first instance in the instance
+    //order of the tree.
+    std::uint32_t childOrFirst;
+    //0 for inner nodes
+    std::uint32_t instanceCount;
+};
+
+static_assert(sizeof(BvhNode) == 32, "BvhNode must be 32 bytes");
+
+struct RayHit
+{
+    std::uint32_t instance;
+    //Where the ray enters the bounding box of the instance, in units of the direction
+    float distance;
+};
+
+//A bounding volume hierarchy of static instances, given by their bounding boxes. It's built
+//with the surface area heuristic over 16 bins per axis, which is close to a full SAH build in
+//quality and O(n log n). The top levels are split between threads.
+//
+//    Bvh bvh;
+//    bvh.build(bounds.data(), bounds.size(), std::thread::hardware_concurrency());
+//    bvh.cullFrustum(extractFrustum(projection * view), visible);
+class Bvh
+{
+public:
+    static const int binNumber = 16;
+    static const std::uint32_t maxLeafSize = 4;
+    //Cost of visiting a node relative to testing an instance. The node test is as cheap, but a
+    //smaller tree is faster to walk and to keep in the cache.
+    static constexpr float traversalCost = 2.0f;
+    //Deeper nodes are split at the median, so the depth is bounded and the traversal stack
+    //can have a fixed size
+    static const int medianSplitDepth = 32;
+    static const int maxDepth = 64;
+    //Smaller subtrees aren't worth a thread
+    static const std::uint32_t parallelBuildThreshold = 16384;
+
+    void build(const Aabb* instanceBounds, std::size_t instanceNumber, unsigned threadNumber = 1)
+    {
+        nodes.clear();
+        //The build partitions copies of the boxes instead of indices, so it reads them
+        //sequentially
+        buildInstances.resize(instanceNumber);
+        for (std::size_t i = 0; i < instanceNumber; ++i)
+        {
+            buildInstances[i].bounds = instanceBounds[i];
+            buildInstances[i].index = static_cast<std::uint32_t>(i);
+        }
+
+        if (instanceNumber > 0)
+        {
+            int parallelDepth = 0;
+            while ((1u << parallelDepth) < threadNumber)
+                ++parallelDepth;
+            nodes.reserve(instanceNumber / maxLeafSize * 2 + 1);
+            buildNode(nodes, 0, static_cast<std::uint32_t>(instanceNumber), 0, parallelDepth);
+        }
+
+        //The boxes are kept in leaf order, so a leaf reads its instances sequentially
+        indices.resize(instanceNumber);
+        leafBounds.resize(instanceNumber);
+        for (std::size_t i = 0; i < instanceNumber; ++i)
+        {
+            indices[i] = buildInstances[i].index;
+            leafBounds[i] = buildInstances[i].bounds;
+        }
+        std::vector<BuildInstance>().swap(buildInstances);
+    }
+
+    //Appends the instances whose bounding boxes intersect the frustum. Planes which contain a
+    //whole node aren't tested again below it.
+    void cullFrustum(const Frustum& frustum, std::vector<std::uint32_t>& visible) const
+    {
+        if (nodes.empty())
+            return;
+        const unsigned allPlanes = (1u << 6) - 1;
+        std::uint32_t stack[maxDepth];
+        unsigned stackPlanes[maxDepth];
+        int stackSize = 0;
+        std::uint32_t nodeIndex = 0;
+        unsigned planes = allPlanes;
+        for (;;)
+        {
+            const auto& node = nodes[nodeIndex];
+            bool outside = false;
+            if (planes != 0)
+                outside = !testPlanes(frustum, node.bounds, planes);
+            if (!outside)
+            {
+                if (node.instanceCount > 0)
+                {
+                    for (auto i = node.childOrFirst; i < node.childOrFirst + node.instanceCount; ++i)
+                    {
+                        auto instancePlanes = planes;
+                        if (instancePlanes == 0 || testPlanes(frustum, leafBounds[i], instancePlanes))
+                            visible.push_back(indices[i]);
+                    }
+                }
+                else
+                {
+                    stack[stackSize] = node.childOrFirst;
+                    stackPlanes[stackSize++] = planes;
+                    ++nodeIndex;
+                    continue;
+                }
+            }
+            if (stackSize == 0)
+                break;
+            nodeIndex = stack[--stackSize];
+            planes = stackPlanes[stackSize];
+        }
+    }
+
+    //Finds the closest instance whose bounding box the ray hits within maxDistance. The children
+    //are visited near first, so farther subtrees are usually skipped.
+    bool intersectRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit) const
+    {
+        if (nodes.empty())
+            return false;
+        Ray ray;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            ray.origin[axis] = origin[axis];
+            ray.inverseDirection[axis] = 1.0f / direction[axis];
+        }
+        hit.instance = std::numeric_limits<std::uint32_t>::max();
+        hit.distance = maxDistance;
+
+        std::uint32_t stack[maxDepth];
+        int stackSize = 0;
+        std::uint32_t nodeIndex = 0;
+        float entry;
+        if (!intersectBox(ray, nodes[0].bounds, hit.distance, entry))
+            return false;
+        for (;;)
+        {
+            const auto& node = nodes[nodeIndex];
+            if (node.instanceCount > 0)
+            {
+                for (auto i = node.childOrFirst; i < node.childOrFirst + node.instanceCount; ++i)
+                {
+                    if (intersectBox(ray, leafBounds[i], hit.distance, entry))
+                    {
+                        hit.instance = indices[i];
+                        hit.distance = entry;
+                    }
+                }
+            }
+            else
+            {
+                std::uint32_t children[2] = {nodeIndex + 1, node.childOrFirst};
+                float entries[2];
+                bool hits[2] =
+                {
+                    intersectBox(ray, nodes[children[0]].bounds, hit.distance, entries[0]),
+                    intersectBox(ray, nodes[children[1]].bounds, hit.distance, entries[1])
+                };
+                if (hits[0] && hits[1])
+                {
+                    int nearChild = entries[0] <= entries[1] ? 0 : 1;
+                    stack[stackSize++] = children[1 - nearChild];
+                    nodeIndex = children[nearChild];
+                    continue;
+                }
+                if (hits[0] || hits[1])
+                {
+                    nodeIndex = children[hits[0] ? 0 : 1];
+                    continue;
+                }
+            }
+            //The stacked nodes may be farther than a hit found since, they are tested again
+            bool found = false;
+            while (stackSize > 0 && !found)
+            {
+                nodeIndex = stack[--stackSize];
+                found = intersectBox(ray, nodes[nodeIndex].bounds, hit.distance, entry);
+            }
+            if (!found)
+                break;
+        }
+        return hit.instance != std::numeric_limits<std::uint32_t>::max();
+    }
+
+    const std::vector<BvhNode>& getNodes() const
+    {
+        return nodes;
+    }
+
+    //The instances in the order of the leaves
+    const std::vector<std::uint32_t>& getInstanceOrder() const
+    {
+        return indices;
+    }
+
+    std::size_t getMemoryUsage() const
+    {
+        return nodes.size() * sizeof(BvhNode) + indices.size() * sizeof(std::uint32_t) + leafBounds.size() * sizeof(Aabb);
+    }
+
+private:
+    struct BuildInstance
+    {
+        Aabb bounds;
+        std::uint32_t index;
+
+        //Twice the centroid, which bins the same
+        float getCentroid(int axis) const
+        {
+            return bounds.min[axis] + bounds.max[axis];
+        }
+    };
+
+    struct Ray
+    {
+        float origin[3];
+        float inverseDirection[3];
+    };
+
+    //Slab test. entry is where the ray enters the box, or 0 if it starts inside.
+    static bool intersectBox(const Ray& ray, const Aabb& box, float maxDistance, float& entry)
+    {
+        float near = 0.0f, far = maxDistance;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            float t0 = (box.min[axis] - ray.origin[axis]) * ray.inverseDirection[axis];
+            float t1 = (box.max[axis] - ray.origin[axis]) * ray.inverseDirection[axis];
+            //Written so a NaN (the ray in the plane of a face) doesn't change near and far
+            near = std::max(near, std::min(t0, t1));
+            far = std::min(far, std::max(t0, t1));
+        }
+        entry = near;
+        return near <= far;
+    }
+
+    //Clears the bits of the planes which contain the whole box. Returns false if the box is
+    //outside of one of them.
+    static bool testPlanes(const Frustum& frustum, const Aabb& box, unsigned& planes)
+    {
+        for (int p = 0; p < 6; ++p)
+        {
+            if ((planes & (1u << p)) == 0)
+                continue;
+            const float* plane = frustum.planes[p];
+            //The corners farthest along and against the normal
+            float farthest = plane[3], nearest = plane[3];
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                bool positive = plane[axis] >= 0.0f;
+                farthest += plane[axis] * (positive ? box.max[axis] : box.min[axis]);
+                nearest += plane[axis] * (positive ? box.min[axis] : box.max[axis]);
+            }
+            if (farthest < 0.0f)
+                return false;
+            if (nearest >= 0.0f)
+                planes &= ~(1u << p);
+        }
+        return true;
+    }
+
+    //Builds the subtree of buildInstances[begin, end) at the end of out, depth-first. While
+    //parallelDepth > 0 the first child is built by another thread into its own array, which
+    //is then moved into out with its node indices relocated.
+    void buildNode(std::vector<BvhNode>& out, std::uint32_t begin, std::uint32_t end, int depth, int parallelDepth)
+    {
+        auto nodeIndex = out.size();
+        BvhNode node;
+        node.bounds = makeEmptyAabb();
+        Aabb centroidBounds = makeEmptyAabb();
+        for (auto i = begin; i < end; ++i)
+        {
+            const auto& instance = buildInstances[i];
+            growAabb(node.bounds, instance.bounds);
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                auto centroid = instance.getCentroid(axis);
+                centroidBounds.min[axis] = std::min(centroidBounds.min[axis], centroid);
+                centroidBounds.max[axis] = std::max(centroidBounds.max[axis], centroid);
+            }
+        }
+        node.childOrFirst = begin;
+        node.instanceCount = end - begin;
+        out.push_back(node);
+        if (end - begin <= 1)
+            return;
+
+        auto mid = split(begin, end, depth, node.bounds, centroidBounds);
+        if (mid == begin)
+            return;
+        out[nodeIndex].instanceCount = 0;
+
+        if (parallelDepth > 0 && end - begin >= parallelBuildThreshold)
+        {
+            std::vector<BvhNode> first, second;
+            std::thread thread([this, &first, begin, mid, depth, parallelDepth]()
+            {
+                buildNode(first, begin, mid, depth + 1, parallelDepth - 1);
+            });
+            buildNode(second, mid, end, depth + 1, parallelDepth - 1);
+            thread.join();
+            append(out, first);
+            out[nodeIndex].childOrFirst = static_cast<std::uint32_t>(out.size());
+            append(out, second);
+        }
+        else
+        {
+            buildNode(out, begin, mid, depth + 1, 0);
+            out[nodeIndex].childOrFirst = static_cast<std::uint32_t>(out.size());
+            buildNode(out, mid, end, depth + 1, 0);
+        }
+    }
+
+    static void append(std::vector<BvhNode>& out, const std::vector<BvhNode>& subtree)
+    {
+        auto offset = static_cast<std::uint32_t>(out.size());
+        for (auto node : subtree)
+        {
+            if (node.instanceCount == 0)
+                node.childOrFirst += offset;
+            out.push_back(node);
+        }
+    }
+
+    //Partitions buildInstances[begin, end) and returns where the second child starts, or begin for a
+    //leaf
+    std::uint32_t split(std::uint32_t begin, std::uint32_t end, int depth, const Aabb& nodeBounds, const Aabb& centroidBounds)
+    {
+        auto count = end - begin;
+        int largestAxis = 0;
+        for (int axis = 1; axis < 3; ++axis)
+        {
+            if (centroidBounds.max[axis] - centroidBounds.min[axis] > centroidBounds.max[largestAxis] - centroidBounds.min[largestAxis])
+                largestAxis = axis;
+        }
+        auto medianSplit = [&]()
+        {
+            auto mid = begin + count / 2;
+            std::nth_element(buildInstances.begin() + begin, buildInstances.begin() + mid, buildInstances.begin() + end,
+                [largestAxis](const BuildInstance& a, const BuildInstance& b)
+            {
+                return a.getCentroid(largestAxis) < b.getCentroid(largestAxis);
+            });
+            return mid;
+        };
+        if (centroidBounds.max[largestAxis] <= centroidBounds.min[largestAxis])
+            return count <= maxLeafSize ? begin : begin + count / 2;
+        if (depth >= medianSplitDepth)
+            return count <= maxLeafSize ? begin : medianSplit();
+
+        struct Bin
+        {
+            Aabb bounds;
+            std::uint32_t count;
+        };
+        Bin bins[3][binNumber];
+        float scales[3];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+            scales[axis] = extent > 0.0f ? binNumber / extent : 0.0f;
+            for (int b = 0; b < binNumber; ++b)
+            {
+                bins[axis][b].bounds = makeEmptyAabb();
+                bins[axis][b].count = 0;
+            }
+        }
+        auto getBin = [&](const BuildInstance& instance, int axis)
+        {
+            int b = static_cast<int>((instance.getCentroid(axis) - centroidBounds.min[axis]) * scales[axis]);
+            return std::min(b, binNumber - 1);
+        };
+        for (auto i = begin; i < end; ++i)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                auto& bin = bins[axis][getBin(buildInstances[i], axis)];
+                growAabb(bin.bounds, buildInstances[i].bounds);
+                ++bin.count;
+            }
+        }
+
+        //Cost of each split plane from a sweep in both directions
+        float bestCost = std::numeric_limits<float>::infinity();
+        int bestAxis = -1, bestPlane = 0;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (scales[axis] == 0.0f)
+                continue;
+            float leftCosts[binNumber - 1];
+            Aabb box = makeEmptyAabb();
+            std::uint32_t leftCount = 0;
+            for (int plane = 0; plane < binNumber - 1; ++plane)
+            {
+                growAabb(box, bins[axis][plane].bounds);
+                leftCount += bins[axis][plane].count;
+                leftCosts[plane] = leftCount > 0 ? getHalfArea(box) * leftCount : -1.0f;
+            }
+            box = makeEmptyAabb();
+            std::uint32_t rightCount = 0;
+            for (int plane = binNumber - 2; plane >= 0; --plane)
+            {
+                growAabb(box, bins[axis][plane + 1].bounds);
+                rightCount += bins[axis][plane + 1].count;
+                if (rightCount == 0 || leftCosts[plane] < 0.0f)
+                    continue;
+                float cost = leftCosts[plane] + getHalfArea(box) * rightCount;
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestPlane = plane;
+                }
+            }
+        }
+
+        float splitCost = traversalCost + bestCost / getHalfArea(nodeBounds);
+        if (bestAxis < 0 || (count <= maxLeafSize && splitCost >= static_cast<float>(count)))
+            return count <= maxLeafSize ? begin : medianSplit();
+
+        auto it = std::partition(buildInstances.begin() + begin, buildInstances.begin() + end, [&](const BuildInstance& instance)
+        {
+            return getBin(instance, bestAxis) <= bestPlane;
+        });
+        return static_cast<std::uint32_t>(it - buildInstances.begin());
+    }
+
+    std::vector<BvhNode> nodes;
+    std::vector<std::uint32_t> indices;
+    std::vector<Aabb> leafBounds;
+    //Only during build()
+    std::vector<BuildInstance> buildInstances;
+};
+
+#endif
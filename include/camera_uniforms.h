@@ -0,0 +1,103 @@
+#ifndef CAMERA_UNIFORMS_H
+#define CAMERA_UNIFORMS_H
+
+#include <opengl_loader.h>
+#include <shader_loader.h>
+#include <gl_state_cache.h>
+
+#include <glm/glm.hpp>
+
+#include <cstring>
+
+//Memory layout of the Camera uniform block. With std140 a mat4 is four vec4 columns, which is
+//exactly how glm stores it, so we can copy the struct into the buffer as it is.
+//
+//    layout (std140) uniform Camera
+//    {
+//        mat4 view;
+//        mat4 projection;
+//        mat4 viewProj;
+//    };
+struct CameraBlock
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProj;
+};
+
+static_assert(sizeof(CameraBlock) == 3 * 16 * sizeof(float), "CameraBlock doesn't match the std140 layout");
+
+//Uniform buffer holding the camera matrices of the frame. It's bound to cameraBlockBinding, and
+//ShaderLoader binds the Camera block of each program there, so the matrices are uploaded once
+//per frame no matter how many programs draw with them. viewProj is computed here once instead
+//of multiplying projection * view in each vertex.
+//
+//    CameraUniformBuffer camera;
+//    while (...)
+//    {
+//        camera.update(view, projection);
+//        //draw with any program
+//    }
+class CameraUniformBuffer
+{
+public:
+    //Requires a current context
+    CameraUniformBuffer() :
+        block(), uploaded{false}
+    {
+        glGenBuffers(1, &bufferId);
+        glBindBuffer(GL_UNIFORM_BUFFER, bufferId);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, cameraBlockBinding, bufferId);
+    }
+
+    CameraUniformBuffer(const CameraUniformBuffer&) = delete;
+    CameraUniformBuffer& operator=(const CameraUniformBuffer&) = delete;
+
+    //The chapters destroy it after glfwTerminate(), when the buffer is already deleted with the
+    //context
+    ~CameraUniformBuffer()
+    {
+        if (glfwGetCurrentContext() != NULL)
+            glDeleteBuffers(1, &bufferId);
+    }
+
+    //Call it once per frame before drawing. The buffer is only written when the matrices change.
+    //It's bound to GL_UNIFORM_BUFFER for the upload: through state if you pass one, where it stays
+    //bound, otherwise directly and unbound afterwards.
+    void update(const glm::mat4& view, const glm::mat4& projection, GLStateCache* state = NULL)
+    {
+        if (uploaded && std::memcmp(&view, &block.view, sizeof(view)) == 0 &&
+            std::memcmp(&projection, &block.projection, sizeof(projection)) == 0)
+            return;
+        block.view = view;
+        block.projection = projection;
+        block.viewProj = projection * view;
+        if (state != NULL)
+            state->bindBuffer(GL_UNIFORM_BUFFER, bufferId);
+        else
+            glBindBuffer(GL_UNIFORM_BUFFER, bufferId);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlock), &block);
+        if (state == NULL)
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        uploaded = true;
+    }
+
+    const CameraBlock& getBlock() const
+    {
+        return block;
+    }
+
+    GLuint getBufferId() const
+    {
+        return bufferId;
+    }
+
+private:
+    GLuint bufferId;
+    CameraBlock block;
+    bool uploaded;
+};
+
+#endif
@@ -0,0 +1,301 @@
+#ifndef FRUSTUM_CULLING_H
+#define FRUSTUM_CULLING_H
+
+#include <glm/glm.hpp>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FRUSTUM_CULLING_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRUSTUM_CULLING_SSE
+#endif
+
+#include <job_system.h>
+
+#include <cmath>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+//The six planes of a view frustum as (a, b, c, d), where ax + by + cz + d is the signed
+//distance of (x, y, z) from the plane and is positive inside
+struct Frustum
+{
+    float planes[6][4];
+};
+
+//Gribb and Hartmann's extraction from projection * view. With a model matrix too, the planes are
+//in the model's space.
+inline Frustum extractFrustum(const glm::mat4& viewProj)
+{
+    //Left, right, bottom, top, near, far: -w <= x, y, z <= w in clip space, so each plane is
+    //the last row of the matrix plus or minus another row. glm is column-major.
+    Frustum frustum;
+    for (int i = 0; i < 6; ++i)
+    {
+        int row = i / 2;
+        float sign = i % 2 == 0 ? 1.0f : -1.0f;
+        for (int column = 0; column < 4; ++column)
+            frustum.planes[i][column] = viewProj[column][3] + sign * viewProj[column][row];
+        //Normalized, so the distance is in world units and can be compared with a radius
+        float length = std::sqrt(frustum.planes[i][0] * frustum.planes[i][0] + frustum.planes[i][1] * frustum.planes[i][1] +
+            frustum.planes[i][2] * frustum.planes[i][2]);
+        for (int column = 0; column < 4; ++column)
+            frustum.planes[i][column] /= length;
+    }
+    return frustum;
+}
+
+//Bounding spheres in structure of arrays layout, so the culling loads 4 or 8 of them with one
+//instruction per component
+class BoundingSpheres
+{
+public:
+    void reserve(std::size_t sphereNumber)
+    {
+        x.reserve(sphereNumber);
+        y.reserve(sphereNumber);
+        z.reserve(sphereNumber);
+        radius.reserve(sphereNumber);
+    }
+
+    void clear()
+    {
+        x.clear();
+        y.clear();
+        z.clear();
+        radius.clear();
+    }
+
+    std::uint32_t add(const glm::vec3& center, float sphereRadius)
+    {
+        x.push_back(center.x);
+        y.push_back(center.y);
+        z.push_back(center.z);
+        radius.push_back(sphereRadius);
+        return static_cast<std::uint32_t>(x.size() - 1);
+    }
+
+    void set(std::uint32_t index, const glm::vec3& center, float sphereRadius)
+    {
+        x[index] = center.x;
+        y[index] = center.y;
+        z[index] = center.z;
+        radius[index] = sphereRadius;
+    }
+
+    std::size_t size() const
+    {
+        return x.size();
+    }
+
+    const float* getX() const
+    {
+        return x.data();
+    }
+
+    const float* getY() const
+    {
+        return y.data();
+    }
+
+    const float* getZ() const
+    {
+        return z.data();
+    }
+
+    const float* getRadius() const
+    {
+        return radius.data();
+    }
+
+private:
+    std::vector<float> x, y, z, radius;
+};
+
+//The spheres in [begin, end) which intersect the frustum are written to visible, in order.
+//visible must have room for end - begin indices. Returns their number. The test is
+//conservative: a sphere outside of the frustum near one of its edges can pass.
+inline std::size_t cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, std::size_t begin, std::size_t end,
+    std::uint32_t* visible)
+{
+    auto x = spheres.getX(), y = spheres.getY(), z = spheres.getZ(), radius = spheres.getRadius();
+    std::size_t visibleNumber = 0;
+    auto i = begin;
+#if defined(FRUSTUM_CULLING_AVX)
+    const std::size_t batchSize = 8;
+    for (; i + batchSize <= end; i += batchSize)
+    {
+        auto batchX = _mm256_loadu_ps(x + i), batchY = _mm256_loadu_ps(y + i), batchZ = _mm256_loadu_ps(z + i);
+        auto negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius + i));
+        auto inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p)
+        {
+            const float* plane = frustum.planes[p];
+            auto distance = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(batchX, _mm256_set1_ps(plane[0])), _mm256_mul_ps(batchY, _mm256_set1_ps(plane[1]))),
+                _mm256_add_ps(_mm256_mul_ps(batchZ, _mm256_set1_ps(plane[2])), _mm256_set1_ps(plane[3])));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+        }
+        int mask = _mm256_movemask_ps(inside);
+        //Branchless compaction: every lane is written, only the visible ones advance
+        for (std::size_t lane = 0; lane < batchSize; ++lane)
+        {
+            visible[visibleNumber] = static_cast<std::uint32_t>(i + lane);
+            visibleNumber += (mask >> lane) & 1;
+        }
+    }
+#elif defined(FRUSTUM_CULLING_SSE)
+    const std::size_t batchSize = 4;
+    for (; i + batchSize <= end; i += batchSize)
+    {
+        auto batchX = _mm_loadu_ps(x + i), batchY = _mm_loadu_ps(y + i), batchZ = _mm_loadu_ps(z + i);
+        auto negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+        auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p)
+        {
+            const float* plane = frustum.planes[p];
+            auto distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(batchX, _mm_set1_ps(plane[0])), _mm_mul_ps(batchY, _mm_set1_ps(plane[1]))),
+                _mm_add_ps(_mm_mul_ps(batchZ, _mm_set1_ps(plane[2])), _mm_set1_ps(plane[3])));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (std::size_t lane = 0; lane < batchSize; ++lane)
+        {
+            visible[visibleNumber] = static_cast<std::uint32_t>(i + lane);
+            visibleNumber += (mask >> lane) & 1;
+        }
+    }
+#endif
+    //The rest, or everything without SIMD
+    for (; i < end; ++i)
+    {
+        bool inside = true;
+        for (int p = 0; p < 6; ++p)
+        {
+            const float* plane = frustum.planes[p];
+            inside &= x[i] * plane[0] + y[i] * plane[1] + z[i] * plane[2] + plane[3] >= -radius[i];
+        }
+        visible[visibleNumber] = static_cast<std::uint32_t>(i);
+        visibleNumber += inside ? 1 : 0;
+    }
+    return visibleNumber;
+}
+
+//The spheres which passed the last FrustumCuller::cull(), a view of the culler's buffer which is
+//valid until the next cull
+struct VisibleSpheres
+{
+    const std::uint32_t* data;
+    std::size_t number;
+
+    std::size_t size() const
+    {
+        return number;
+    }
+
+    bool empty() const
+    {
+        return number == 0;
+    }
+
+    std::uint32_t operator[](std::size_t i) const
+    {
+        return data[i];
+    }
+
+    const std::uint32_t* begin() const
+    {
+        return data;
+    }
+
+    const std::uint32_t* end() const
+    {
+        return data + number;
+    }
+};
+
+//Spheres are culled in parallel in blocks of this size, one job per block. A multiple of 8, so
+//only the last block has a scalar tail.
+const std::size_t frustumCullingBlockSize = 16384;
+
+//Keeps the list of visible spheres between frames, so culling doesn't allocate. The list is a
+//plain array which only grows, so it isn't cleared or initialized before each cull.
+//
+//    auto visible = culler.cull(extractFrustum(projection * view), spheres);
+//    for (auto i : visible)
+//        models[visibleNumber++] = allModels[i];
+class FrustumCuller
+{
+public:
+    FrustumCuller() :
+        capacity{0}, visibleNumber{0}
+    {
+    }
+
+    VisibleSpheres cull(const Frustum& frustum, const BoundingSpheres& spheres)
+    {
+        reserve(spheres.size());
+        visibleNumber = cullSpheres(frustum, spheres, 0, spheres.size(), visible.get());
+        return getVisible();
+    }
+
+    //Culls the blocks of spheres on the workers of jobs, each into its own part of the list, then
+    //moves the parts together. It must be called by one of the workers. The workers only pay off
+    //for many thousands of spheres.
+    VisibleSpheres cullParallel(const Frustum& frustum, const BoundingSpheres& spheres, JobSystem& jobs)
+    {
+        auto sphereNumber = spheres.size();
+        auto blockNumber = (sphereNumber + frustumCullingBlockSize - 1) / frustumCullingBlockSize;
+        if (blockNumber <= 1 || jobs.getThreadNumber() == 1)
+            return cull(frustum, spheres);
+        reserve(sphereNumber);
+        if (blockCounts.size() < blockNumber)
+            blockCounts.resize(blockNumber);
+        jobs.parallelFor(0, blockNumber, 1, [&](std::size_t begin, std::size_t end)
+        {
+            for (auto block = begin; block < end; ++block)
+            {
+                auto first = block * frustumCullingBlockSize;
+                auto last = std::min(sphereNumber, first + frustumCullingBlockSize);
+                blockCounts[block] = cullSpheres(frustum, spheres, first, last, visible.get() + first);
+            }
+        });
+
+        visibleNumber = blockCounts[0];
+        for (std::size_t block = 1; block < blockNumber; ++block)
+        {
+            auto first = visible.get() + block * frustumCullingBlockSize;
+            std::copy(first, first + blockCounts[block], visible.get() + visibleNumber);
+            visibleNumber += blockCounts[block];
+        }
+        return getVisible();
+    }
+
+    VisibleSpheres getVisible() const
+    {
+        VisibleSpheres result = {visible.get(), visibleNumber};
+        return result;
+    }
+
+private:
+    void reserve(std::size_t sphereNumber)
+    {
+        if (sphereNumber <= capacity)
+            return;
+        visible.reset(new std::uint32_t[sphereNumber]);
+        capacity = sphereNumber;
+    }
+
+private:
+    std::unique_ptr<std::uint32_t[]> visible;
+    std::size_t capacity;
+    std::size_t visibleNumber;
+    std::vector<std::size_t> blockCounts;
+};
+
+#endif
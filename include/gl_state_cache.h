@@ -0,0 +1,264 @@
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include <opengl_loader.h>
+
+#include <vector>
+#include <cstddef>
+
+//Remembers the bindings and capabilities we set and drops the calls which wouldn't change
+//anything, e.g. binding the same program, VAO and textures in each frame. It only knows about the
+//calls made through it, so call invalidate() after code that changes the state directly (e.g. a
+//library), then the next call of each kind is issued again. ShaderLoader, CameraUniformBuffer,
+//InstanceBuffer, IndexBufferData and RingBuffer take an optional cache for the state they change
+//per frame; their constructors bind directly, so create them before the frame loop or invalidate
+//the cache afterwards.
+//
+//It doesn't call OpenGL before the first bind, so it can be a global object created before
+//the context.
+//
+//    static GLStateCache glState;
+//    glState.useProgram(shader.getProgramId());
+//    glState.bindTexture(0, GL_TEXTURE_2D, texture);
+//    glState.bindVertexArray(vao);
+class GLStateCache
+{
+public:
+    struct Stats
+    {
+        unsigned issued;
+        unsigned elided;
+    };
+
+    GLStateCache() :
+        program{unknown}, vertexArray{unknown}, activeUnit{unknown}, restartIndex{0},
+        restartIndexKnown{false}, fixedIndexRestart{FixedIndexRestart::Unknown}, stats{0, 0}
+    {
+    }
+
+    void useProgram(GLuint id)
+    {
+        if (update(program, id))
+            glUseProgram(id);
+    }
+
+    //The element array buffer is part of the VAO, so it's forgotten when the VAO changes
+    void bindVertexArray(GLuint id)
+    {
+        if (!update(vertexArray, id))
+            return;
+        glBindVertexArray(id);
+        for (auto& buffer : buffers)
+        {
+            if (buffer.target == GL_ELEMENT_ARRAY_BUFFER)
+                buffer.id = unknown;
+        }
+    }
+
+    void bindBuffer(GLenum target, GLuint id)
+    {
+        if (update(findBinding(buffers, target).id, id))
+            glBindBuffer(target, id);
+    }
+
+    //Binds an indexed target, e.g. a uniform block binding. It's always issued, since the ranges
+    //are not cached, but it binds the generic target too, so that's recorded.
+    void bindBufferRange(GLenum target, GLuint index, GLuint id, GLintptr offset, GLsizeiptr size)
+    {
+        ++stats.issued;
+        findBinding(buffers, target).id = id;
+        glBindBufferRange(target, index, id, offset, size);
+    }
+
+    //Selects the unit with glActiveTexture only if the texture has to be bound
+    void bindTexture(GLuint unit, GLenum target, GLuint id)
+    {
+        if (unit >= textureUnits.size())
+            textureUnits.resize(unit + 1);
+        if (!update(findBinding(textureUnits[unit].textures, target).id, id))
+            return;
+        setActiveTexture(unit);
+        glBindTexture(target, id);
+    }
+
+    void bindSampler(GLuint unit, GLuint id)
+    {
+        if (unit >= textureUnits.size())
+            textureUnits.resize(unit + 1);
+        if (update(textureUnits[unit].sampler, id))
+            glBindSampler(unit, id);
+    }
+
+    void enable(GLenum capability)
+    {
+        setEnabled(capability, true);
+    }
+
+    void disable(GLenum capability)
+    {
+        setEnabled(capability, false);
+    }
+
+    void setEnabled(GLenum capability, bool enabled)
+    {
+        auto& state = findCapability(capability);
+        if (state.known && state.enabled == enabled)
+        {
+            ++stats.elided;
+            return;
+        }
+        ++stats.issued;
+        state.known = true;
+        state.enabled = enabled;
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+
+    //Enables primitive restart at index or disables it. index must be the largest value of the
+    //index type of the draws (see IndexBufferData). Where GL_PRIMITIVE_RESTART_FIXED_INDEX is
+    //supported it's used instead, so only the capability is set and draws of different index types
+    //need no call. Otherwise the index is set only when it changes.
+    void setPrimitiveRestart(bool enabled, GLuint index)
+    {
+        if (fixedIndexRestart == FixedIndexRestart::Unknown)
+        {
+            fixedIndexRestart = isFixedIndexPrimitiveRestartSupported() ?
+                FixedIndexRestart::Supported : FixedIndexRestart::Unsupported;
+        }
+        if (fixedIndexRestart == FixedIndexRestart::Supported)
+        {
+            setEnabled(GL_PRIMITIVE_RESTART_FIXED_INDEX, enabled);
+            return;
+        }
+        setEnabled(GL_PRIMITIVE_RESTART, enabled);
+        if (!enabled)
+            return;
+        if (restartIndexKnown && restartIndex == index)
+        {
+            ++stats.elided;
+            return;
+        }
+        ++stats.issued;
+        restartIndexKnown = true;
+        restartIndex = index;
+        glPrimitiveRestartIndex(index);
+    }
+
+    //Forgets everything, so the next calls are issued
+    void invalidate()
+    {
+        program = vertexArray = activeUnit = unknown;
+        restartIndexKnown = false;
+        buffers.clear();
+        textureUnits.clear();
+        capabilities.clear();
+    }
+
+    //Counts the calls since the last resetStats(). Call it at the start of each frame to get
+    //per frame numbers.
+    Stats getStats() const
+    {
+        return stats;
+    }
+
+    void resetStats()
+    {
+        stats.issued = stats.elided = 0;
+    }
+
+private:
+    //No object has this name, so a binding with this value is always updated
+    static const GLuint unknown = 0xFFFFFFFF;
+
+    struct Binding
+    {
+        GLenum target;
+        GLuint id;
+    };
+
+    struct TextureUnit
+    {
+        TextureUnit() :
+            sampler{unknown}
+        {
+        }
+
+        std::vector<Binding> textures;
+        GLuint sampler;
+    };
+
+    //Asked on the first setPrimitiveRestart(), since the cache may be created before the context
+    enum class FixedIndexRestart
+    {
+        Unknown,
+        Supported,
+        Unsupported
+    };
+
+    struct Capability
+    {
+        GLenum capability;
+        bool known;
+        bool enabled;
+    };
+
+    //Returns true if the call must be issued
+    bool update(GLuint& current, GLuint id)
+    {
+        if (current == id)
+        {
+            ++stats.elided;
+            return false;
+        }
+        ++stats.issued;
+        current = id;
+        return true;
+    }
+
+    //Selecting the unit is a state change too, so it's counted
+    void setActiveTexture(GLuint unit)
+    {
+        if (update(activeUnit, unit))
+            glActiveTexture(static_cast<GLenum>(static_cast<int>(GL_TEXTURE0) + static_cast<int>(unit)));
+    }
+
+    //There are only a few targets in use, so a linear search is faster than a map
+    static Binding& findBinding(std::vector<Binding>& bindings, GLenum target)
+    {
+        for (auto& binding : bindings)
+        {
+            if (binding.target == target)
+                return binding;
+        }
+        Binding binding = {target, unknown};
+        bindings.push_back(binding);
+        return bindings.back();
+    }
+
+    Capability& findCapability(GLenum capability)
+    {
+        for (auto& state : capabilities)
+        {
+            if (state.capability == capability)
+                return state;
+        }
+        Capability state = {capability, false, false};
+        capabilities.push_back(state);
+        return capabilities.back();
+    }
+
+private:
+    GLuint program, vertexArray, activeUnit;
+    //Every value is a valid restart index, so it has a flag instead of the unknown value
+    GLuint restartIndex;
+    bool restartIndexKnown;
+    FixedIndexRestart fixedIndexRestart;
+    std::vector<Binding> buffers;
+    std::vector<TextureUnit> textureUnits;
+    std::vector<Capability> capabilities;
+    Stats stats;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+//64-bit FNV-1a. It's not a cryptographic hash, but it's fast and good enough to build
+//content keys for caches.
+constexpr std::uint64_t fnv1aOffsetBasis = 14695981039346656037ULL;
+constexpr std::uint64_t fnv1aPrime = 1099511628211ULL;
+
+//FNV-1a of a null-terminated string, without the null character. It's constexpr, so for
+//string literals the hash can be computed at compile time.
+constexpr std::uint64_t hashString(const char* str, std::uint64_t hash = fnv1aOffsetBasis)
+{
+    return *str == '\0' ? hash : hashString(str + 1, (hash ^ static_cast<unsigned char>(*str)) * fnv1aPrime);
+}
+
+inline std::uint64_t fnv1a(const void* data, std::size_t size, std::uint64_t hash = fnv1aOffsetBasis)
+{
+    auto bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= fnv1aPrime;
+    }
+    return hash;
+}
+
+//The terminating null character is hashed too, so ("ab", "c") and ("a", "bc") get different
+//hashes when several strings are chained together.
+inline std::uint64_t fnv1a(const std::string& str, std::uint64_t hash = fnv1aOffsetBasis)
+{
+    return fnv1a(str.c_str(), str.size() + 1, hash);
+}
+
+inline std::string toHexString(std::uint64_t value)
+{
+    const char digits[] = "0123456789abcdef";
+    std::string result(16, '0');
+    for (int i = 15; i >= 0; --i)
+    {
+        result[i] = digits[value & 0xF];
+        value >>= 4;
+    }
+    return result;
+}
+
+#endif
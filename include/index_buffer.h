@@ -0,0 +1,191 @@
+#ifndef INDEX_BUFFER_H
+#define INDEX_BUFFER_H
+
+#include <opengl_loader.h>
+#include <gl_state_cache.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <unordered_map>
+
+//Indices packed in the smallest type which can address the vertices, ready for
+//glBufferData(GL_ELEMENT_ARRAY_BUFFER, ...). A cube with 24 vertices needs 1 byte per index
+//instead of 4, most meshes fit in 2 bytes.
+struct IndexBufferData
+{
+    GLenum mode;
+    GLenum type;
+    GLsizei count;
+    //Strips are joined by restartIndex, the largest value of the type
+    bool primitiveRestart;
+    GLuint restartIndex;
+    std::vector<unsigned char> bytes;
+
+    std::size_t getSize() const
+    {
+        return bytes.size();
+    }
+
+    //Uploads to the element buffer of the bound VAO
+    void upload(GLenum usage = GL_STATIC_DRAW) const
+    {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(bytes.size()), bytes.data(), usage);
+    }
+
+    //Draws with the bound VAO. Primitive restart is enabled only for strips, since a list with
+    //all the values of its type uses the restart index as a vertex. With a GLStateCache the
+    //restart state is only set when it changes (see GLStateCache::setPrimitiveRestart()),
+    //without one it's set on every draw.
+    void draw(GLStateCache* state = NULL) const
+    {
+        if (state != NULL)
+            state->setPrimitiveRestart(primitiveRestart, restartIndex);
+        else if (primitiveRestart)
+        {
+            glEnable(GL_PRIMITIVE_RESTART);
+            glPrimitiveRestartIndex(restartIndex);
+        }
+        else
+            glDisable(GL_PRIMITIVE_RESTART);
+        glDrawElements(mode, count, type, NULL);
+    }
+};
+
+//Picks GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT. With primitive restart the
+//largest value of the type is reserved.
+inline GLenum selectIndexType(std::size_t vertexCount, bool primitiveRestart = false)
+{
+    std::size_t reserved = primitiveRestart ? 1 : 0;
+    if (vertexCount + reserved <= 0x100)
+        return GL_UNSIGNED_BYTE;
+    if (vertexCount + reserved <= 0x10000)
+        return GL_UNSIGNED_SHORT;
+    return GL_UNSIGNED_INT;
+}
+
+inline std::size_t getIndexSize(GLenum type)
+{
+    return type == GL_UNSIGNED_BYTE ? 1 : (type == GL_UNSIGNED_SHORT ? 2 : 4);
+}
+
+inline GLuint getRestartIndex(GLenum type)
+{
+    return type == GL_UNSIGNED_BYTE ? 0xFF : (type == GL_UNSIGNED_SHORT ? 0xFFFF : 0xFFFFFFFF);
+}
+
+inline IndexBufferData packIndices(const std::vector<GLuint>& indices, GLenum mode, GLenum type, bool primitiveRestart)
+{
+    IndexBufferData data;
+    data.mode = mode;
+    data.type = type;
+    data.count = static_cast<GLsizei>(indices.size());
+    data.primitiveRestart = primitiveRestart;
+    data.restartIndex = getRestartIndex(type);
+    auto indexSize = getIndexSize(type);
+    data.bytes.resize(indices.size() * indexSize);
+    for (std::size_t i = 0; i < indices.size(); ++i)
+    {
+        if (indexSize == 1)
+            data.bytes[i] = static_cast<std::uint8_t>(indices[i]);
+        else if (indexSize == 2)
+        {
+            auto index = static_cast<std::uint16_t>(indices[i]);
+            std::memcpy(&data.bytes[i * 2], &index, 2);
+        }
+        else
+            std::memcpy(&data.bytes[i * 4], &indices[i], 4);
+    }
+    return data;
+}
+
+//Converts a triangle list to strips joined by restart indices. The triangles keep their
+//winding. It's greedy: a strip starts at the first unused triangle and goes on while there is
+//an unused triangle across its last edge, which works well for grids and meshes exported in
+//a coherent order. Linear in the number of triangles.
+inline std::vector<GLuint> makeTriangleStrips(const GLuint* indices, std::size_t indexCount, GLuint restartIndex)
+{
+    auto triangleCount = indexCount / 3;
+    //Directed edge -> triangles which have it in their winding order
+    std::unordered_multimap<std::uint64_t, std::size_t> edges;
+    edges.reserve(triangleCount * 3);
+    auto edgeKey = [](GLuint from, GLuint to)
+    {
+        return (static_cast<std::uint64_t>(from) << 32) | to;
+    };
+    for (std::size_t t = 0; t < triangleCount; ++t)
+    {
+        for (int corner = 0; corner < 3; ++corner)
+            edges.insert(std::make_pair(edgeKey(indices[t * 3 + corner], indices[t * 3 + (corner + 1) % 3]), t));
+    }
+
+    std::vector<bool> used(triangleCount, false);
+    //Returns the third vertex of an unused triangle with the directed edge, or marks nothing
+    auto takeTriangle = [&](GLuint from, GLuint to, GLuint& third)
+    {
+        auto range = edges.equal_range(edgeKey(from, to));
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            auto t = it->second;
+            if (used[t])
+                continue;
+            used[t] = true;
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                if (indices[t * 3 + corner] == from)
+                {
+                    third = indices[t * 3 + (corner + 2) % 3];
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+
+    std::vector<GLuint> strips;
+    strips.reserve(indexCount);
+    for (std::size_t start = 0; start < triangleCount; ++start)
+    {
+        if (used[start])
+            continue;
+        used[start] = true;
+        if (!strips.empty())
+            strips.push_back(restartIndex);
+        auto stripBegin = strips.size();
+        strips.insert(strips.end(), indices + start * 3, indices + start * 3 + 3);
+        //Triangle k of a strip is (v[k], v[k + 1], v[k + 2]) for even k and (v[k + 1], v[k], v[k + 2])
+        //for odd k, so the next triangle must have the last edge in this direction
+        for (;;)
+        {
+            auto k = strips.size() - stripBegin - 2;
+            auto p = strips[strips.size() - 2];
+            auto q = strips[strips.size() - 1];
+            GLuint third;
+            if (!(k % 2 == 0 ? takeTriangle(p, q, third) : takeTriangle(q, p, third)))
+                break;
+            strips.push_back(third);
+        }
+    }
+    return strips;
+}
+
+//Packs a triangle list in the smallest index type. With makeStrips it's converted to strips
+//with primitive restart, but only if that's smaller than the list (a mesh of disconnected
+//triangles needs 4 indices per triangle as strips).
+inline IndexBufferData buildIndexBuffer(const GLuint* indices, std::size_t indexCount, std::size_t vertexCount, bool makeStrips = false)
+{
+    std::vector<GLuint> list(indices, indices + indexCount);
+    auto listType = selectIndexType(vertexCount);
+    auto listData = packIndices(list, GL_TRIANGLES, listType, false);
+    if (!makeStrips)
+        return listData;
+
+    auto stripType = selectIndexType(vertexCount, true);
+    auto strips = makeTriangleStrips(indices, indexCount, getRestartIndex(stripType));
+    if (strips.size() * getIndexSize(stripType) >= listData.getSize())
+        return listData;
+    return packIndices(strips, GL_TRIANGLE_STRIP, stripType, true);
+}
+
+#endif
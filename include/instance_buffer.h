@@ -0,0 +1,132 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <opengl_loader.h>
+#include <gl_state_cache.h>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+//Per-instance model matrices in a vertex buffer, so a whole scene of the same mesh is drawn by
+//one glDrawElementsInstanced instead of a uniform upload and a draw call per object. A mat4
+//attribute takes four locations, one vec4 column each, and advances once per instance:
+//
+//    layout (location = 3) in mat4 instanceModel;
+//
+//The constructor doesn't call OpenGL, so it can be a global object created before the context.
+//
+//    cubeInstances.attach(vao);
+//    cubeInstances.update(models, modelNumber);
+//    ...
+//    glBindVertexArray(vao);
+//    cubeInstances.draw(GL_TRIANGLES, 36, GL_UNSIGNED_INT);
+class InstanceBuffer
+{
+public:
+    static const GLuint defaultLocation = 3;
+
+    InstanceBuffer() :
+        bufferId{0}, capacity{0}, count{0}
+    {
+    }
+
+    InstanceBuffer(const InstanceBuffer&) = delete;
+    InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+    //The chapters destroy it after glfwTerminate(), when the buffer is already deleted with the
+    //context
+    ~InstanceBuffer()
+    {
+        if (bufferId != 0 && glfwGetCurrentContext() != NULL)
+            glDeleteBuffers(1, &bufferId);
+    }
+
+    //Adds the instance attribute at location..location + 3 to vao. It can be attached to
+    //several VAOs. With state the VAO and the buffer are bound through the cache and stay bound,
+    //otherwise they are bound directly and it leaves no VAO bound.
+    void attach(GLuint vao, GLuint location = defaultLocation, GLStateCache* state = NULL)
+    {
+        if (bufferId == 0)
+            glGenBuffers(1, &bufferId);
+        if (state != NULL)
+        {
+            state->bindVertexArray(vao);
+            state->bindBuffer(GL_ARRAY_BUFFER, bufferId);
+        }
+        else
+        {
+            glBindVertexArray(vao);
+            glBindBuffer(GL_ARRAY_BUFFER, bufferId);
+        }
+        for (GLuint column = 0; column < 4; ++column)
+        {
+            glVertexAttribPointer(location + column, 4, GL_FLOAT, false, sizeof(glm::mat4),
+                reinterpret_cast<void*>(column * sizeof(glm::vec4)));
+            glEnableVertexAttribArray(location + column);
+            glVertexAttribDivisor(location + column, 1);
+        }
+        if (state == NULL)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glBindVertexArray(0);
+        }
+    }
+
+    //Replaces the instances. The old storage is orphaned, so we don't wait for draws which still
+    //read it, and the size only changes when it grows, so the driver can recycle the memory. The
+    //buffer is bound like in attach().
+    void update(const glm::mat4* models, std::size_t modelNumber, GLStateCache* state = NULL)
+    {
+        if (bufferId == 0)
+            glGenBuffers(1, &bufferId);
+        if (modelNumber > capacity)
+            capacity = modelNumber;
+        if (state != NULL)
+            state->bindBuffer(GL_ARRAY_BUFFER, bufferId);
+        else
+            glBindBuffer(GL_ARRAY_BUFFER, bufferId);
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+        if (modelNumber > 0)
+            glBufferSubData(GL_ARRAY_BUFFER, 0, modelNumber * sizeof(glm::mat4), models);
+        if (state == NULL)
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        count = modelNumber;
+    }
+
+    //Draws all the instances with the indices of the bound VAO
+    void draw(GLenum mode, GLsizei indexCount, GLenum indexType) const
+    {
+        if (count > 0)
+            glDrawElementsInstanced(mode, indexCount, indexType, NULL, static_cast<GLsizei>(count));
+    }
+
+    //Points the attribute of the bound VAO at the instances from firstInstance on, so a range of
+    //them can be drawn without the GL 4.2 base instance. The buffer must be bound to
+    //GL_ARRAY_BUFFER. attach() points it at the first instance again.
+    void setFirstInstance(GLuint firstInstance, GLuint location = defaultLocation) const
+    {
+        for (GLuint column = 0; column < 4; ++column)
+        {
+            glVertexAttribPointer(location + column, 4, GL_FLOAT, false, sizeof(glm::mat4),
+                reinterpret_cast<void*>(firstInstance * sizeof(glm::mat4) + column * sizeof(glm::vec4)));
+        }
+    }
+
+    std::size_t getCount() const
+    {
+        return count;
+    }
+
+    GLuint getBufferId() const
+    {
+        return bufferId;
+    }
+
+private:
+    GLuint bufferId;
+    std::size_t capacity;
+    std::size_t count;
+};
+
+#endif
@@ -0,0 +1,437 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <new>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <condition_variable>
+
+class JobSystem;
+struct Job;
+
+//Counts the jobs which were run with it and haven't finished. JobSystem::wait() returns when it
+//drops to 0, and jobs given to JobSystem::runAfter() start then. It must outlive its jobs.
+class JobCounter
+{
+public:
+    JobCounter() :
+        value{0}, finishingJobs{0}
+    {
+    }
+
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool isDone() const
+    {
+        return value.load() == 0 && finishingJobs.load() == 0;
+    }
+
+private:
+    friend class JobSystem;
+
+    std::atomic<int> value;
+    //Jobs which are past their function but still use the counter. The counter is done only when
+    //they left it too, so whoever waits for it can destroy it.
+    std::atomic<int> finishingJobs;
+    std::mutex continuationMutex;
+    std::vector<Job*> continuations;
+};
+
+//A function with its captures stored in place, so running a job doesn't allocate
+struct Job
+{
+    static const std::size_t payloadSize = 48;
+
+    void (*function)(Job& job);
+    JobCounter* counter;
+    //Set from allocation until the job starts, so its slot isn't reused before
+    std::atomic<bool> pending;
+    alignas(8) unsigned char payload[payloadSize];
+};
+
+//A Chase-Lev work-stealing deque of fixed capacity, with the memory orders of Le, Pop, Cohen and
+//Nardelli, "Correct and Efficient Work-Stealing for Weak Memory Models". The owner thread pushes
+//and pops at the bottom, the other threads steal from the top, so the owner works depth first on
+//its newest jobs and the thieves take the oldest, which are usually the biggest.
+class JobDeque
+{
+public:
+    explicit JobDeque(std::size_t capacity) :
+        buffer(new std::atomic<Job*>[capacity]), mask{static_cast<std::int64_t>(capacity) - 1}, topPadding(), top{0},
+        bottomPadding(), bottom{0}, endPadding()
+    {
+    }
+
+    //Owner only. False if it's full.
+    bool push(Job* job)
+    {
+        auto currentBottom = bottom.load(std::memory_order_relaxed);
+        auto currentTop = top.load(std::memory_order_acquire);
+        if (currentBottom - currentTop > mask)
+            return false;
+        buffer[currentBottom & mask].store(job, std::memory_order_relaxed);
+        //Publishes the job to the thieves, which load bottom with acquire
+        bottom.store(currentBottom + 1, std::memory_order_release);
+        return true;
+    }
+
+    //Owner only. NULL if it's empty.
+    Job* pop()
+    {
+        auto currentBottom = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(currentBottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto currentTop = top.load(std::memory_order_relaxed);
+        if (currentTop > currentBottom)
+        {
+            bottom.store(currentBottom + 1, std::memory_order_relaxed);
+            return NULL;
+        }
+        auto job = buffer[currentBottom & mask].load(std::memory_order_relaxed);
+        if (currentTop == currentBottom)
+        {
+            //The last job, a thief may be taking it too
+            if (!top.compare_exchange_strong(currentTop, currentTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                job = NULL;
+            bottom.store(currentBottom + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    //Any thread. NULL if it's empty or another thread took the job first.
+    Job* steal()
+    {
+        auto currentTop = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto currentBottom = bottom.load(std::memory_order_acquire);
+        if (currentTop >= currentBottom)
+            return NULL;
+        auto job = buffer[currentTop & mask].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(currentTop, currentTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return NULL;
+        return job;
+    }
+
+private:
+    static const std::size_t cacheLineSize = 64;
+
+    std::unique_ptr<std::atomic<Job*>[]> buffer;
+    const std::int64_t mask;
+    //The thieves write top and the owner bottom, so they are a cache line apart from each other
+    //and from their neighbors. It's padding rather than alignas, since C++11 new doesn't align the
+    //workers.
+    char topPadding[cacheLineSize];
+    std::atomic<std::int64_t> top;
+    char bottomPadding[cacheLineSize];
+    std::atomic<std::int64_t> bottom;
+    char endPadding[cacheLineSize];
+};
+
+//Runs small jobs on a thread per core, so the CPU work of a frame (animation, culling, sorting,
+//building draw lists) is spread over all of them. The thread which creates it is worker 0 and
+//the others are started by the constructor. Each worker has a deque of jobs and steals from the
+//others when its own is empty. Waiting runs other jobs instead of blocking, so jobs can start
+//jobs and wait for them. The OpenGL calls stay on the thread of the context: it runs the jobs and
+//waits for them, and then uses their results.
+//
+//    JobSystem jobs;
+//    JobCounter animated, culled;
+//    jobs.run([&]() { jobs.parallelFor(0, cubeNumber, 1024, animate); }, &animated);
+//    jobs.runAfter(animated, [&]() { cull(); }, &culled);
+//    jobs.wait(culled);
+//    draw();
+//
+//Jobs can only be started from the workers: the creating thread and the jobs themselves. The
+//captures of a job must be trivially movable and fit in Job::payloadSize bytes, so they're
+//usually references. Each worker has room for jobPoolSize jobs which haven't started.
+class JobSystem
+{
+public:
+    static const std::size_t jobPoolSize = 4096;
+
+    explicit JobSystem(unsigned threadNumber = std::thread::hardware_concurrency()) :
+        stopping{false}, queuedJobs{0}, sleepingWorkers{0}
+    {
+        threadNumber = std::max(1u, threadNumber);
+        for (unsigned i = 0; i < threadNumber; ++i)
+            workers.push_back(std::unique_ptr<Worker>(new Worker(i)));
+        getCurrentWorker() = CurrentWorker{this, 0};
+        for (unsigned i = 1; i < threadNumber; ++i)
+            threads.push_back(std::thread(&JobSystem::workerLoop, this, i));
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    //Wait for the jobs before, the workers stop without running the rest
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping.store(true);
+        }
+        wakeUp.notify_all();
+        for (auto& thread : threads)
+            thread.join();
+        getCurrentWorker() = CurrentWorker{NULL, 0};
+    }
+
+    unsigned getThreadNumber() const
+    {
+        return static_cast<unsigned>(workers.size());
+    }
+
+    //The index of the calling worker, from 0 to getThreadNumber() - 1, e.g. to pick per-thread
+    //buffers in a job. Throws if it isn't one of our workers.
+    unsigned getWorkerIndex() const
+    {
+        const auto& current = getCurrentWorker();
+        if (current.system != this)
+            throw std::string("JobSystem: jobs can only be started and waited for by its workers");
+        return current.index;
+    }
+
+    //Starts function() on any worker. counter, if given, counts it until it returns.
+    template <typename Function>
+    void run(Function function, JobCounter* counter = NULL)
+    {
+        push(makeJob(function, counter));
+    }
+
+    //Starts function() when dependency drops to 0, right away if it's already there
+    template <typename Function>
+    void runAfter(JobCounter& dependency, Function function, JobCounter* counter = NULL)
+    {
+        auto job = makeJob(function, counter);
+        {
+            //The job which takes value to 0 takes the continuations under this lock, so value alone
+            //tells whether it will see this one. finishingJobs may still be 1 after it took them.
+            std::lock_guard<std::mutex> lock(dependency.continuationMutex);
+            if (dependency.value.load() != 0)
+            {
+                dependency.continuations.push_back(job);
+                return;
+            }
+        }
+        //Like the continuations, it starts once the jobs of the dependency left it, so waiting for
+        //the job is enough before destroying the dependency
+        while (dependency.finishingJobs.load() != 0)
+            std::this_thread::yield();
+        push(job);
+    }
+
+    //Runs other jobs until the counter drops to 0
+    void wait(const JobCounter& counter)
+    {
+        auto worker = getWorkerIndex();
+        while (!counter.isDone())
+        {
+            if (!runOneJob(worker))
+                std::this_thread::yield();
+        }
+    }
+
+    //Calls function(rangeBegin, rangeEnd) on ranges which cover [begin, end) and have at most
+    //grainSize indices, on all the workers, and returns when all the calls returned. A range is
+    //split in halves as long as it's bigger than grainSize: one half is left for the others to
+    //steal and the worker goes on with the other, so idle workers take the biggest pieces.
+    template <typename Function>
+    void parallelFor(std::size_t begin, std::size_t end, std::size_t grainSize, const Function& function)
+    {
+        JobCounter counter;
+        runRange(begin, end, std::max<std::size_t>(1, grainSize), &function, &counter);
+        wait(counter);
+    }
+
+private:
+    struct Worker
+    {
+        explicit Worker(unsigned index) :
+            deque(jobPoolSize), jobs(new Job[jobPoolSize]), nextJob{0}, random{index * 2654435761u + 1}
+        {
+            for (std::size_t i = 0; i < jobPoolSize; ++i)
+                jobs[i].pending.store(false, std::memory_order_relaxed);
+        }
+
+        JobDeque deque;
+        std::unique_ptr<Job[]> jobs;
+        std::size_t nextJob;
+        std::uint32_t random;
+    };
+
+    struct CurrentWorker
+    {
+        JobSystem* system;
+        unsigned index;
+    };
+
+    static CurrentWorker& getCurrentWorker()
+    {
+        static thread_local CurrentWorker current = {NULL, 0};
+        return current;
+    }
+
+    //Moves the function out of the job and frees its slot before calling it, so a job can start
+    //any number of jobs: its own slot is never the one they wait for
+    template <typename Function>
+    static void invoke(Job& job)
+    {
+        auto payload = reinterpret_cast<Function*>(job.payload);
+        Function function(std::move(*payload));
+        payload->~Function();
+        job.pending.store(false, std::memory_order_release);
+        function();
+    }
+
+    //Takes the next slot of the worker's pool, running jobs while it's still in use. The slots
+    //in use belong to jobs which haven't started, so running the queued ones frees them. A job
+    //given to runAfter() keeps its slot until its dependency is done.
+    template <typename Function>
+    Job* makeJob(const Function& function, JobCounter* counter)
+    {
+        static_assert(sizeof(Function) <= Job::payloadSize, "The captures of a job don't fit in Job::payloadSize");
+        static_assert(alignof(Function) <= 8, "The captures of a job need more alignment than Job::payload");
+        auto index = getWorkerIndex();
+        auto& worker = *workers[index];
+        auto& job = worker.jobs[worker.nextJob++ % jobPoolSize];
+        while (job.pending.load(std::memory_order_acquire))
+        {
+            if (!runOneJob(index))
+                std::this_thread::yield();
+        }
+        job.pending.store(true, std::memory_order_relaxed);
+        job.function = &invoke<Function>;
+        job.counter = counter;
+        new (job.payload) Function(function);
+        if (counter != NULL)
+            counter->value.fetch_add(1, std::memory_order_relaxed);
+        return &job;
+    }
+
+    void push(Job* job)
+    {
+        auto& worker = *workers[getWorkerIndex()];
+        //A full deque runs the job right away, which is what a worker would do with it next
+        if (!worker.deque.push(job))
+        {
+            execute(*job);
+            return;
+        }
+        queuedJobs.fetch_add(1);
+        if (sleepingWorkers.load() > 0)
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            wakeUp.notify_one();
+        }
+    }
+
+    void execute(Job& job)
+    {
+        //The slot may be reused as soon as the function starts
+        auto counter = job.counter;
+        job.function(job);
+        if (counter == NULL)
+            return;
+        counter->finishingJobs.fetch_add(1);
+        //The last job of the counter starts the ones which waited for it
+        std::vector<Job*> ready;
+        if (counter->value.fetch_sub(1) == 1)
+        {
+            std::lock_guard<std::mutex> lock(counter->continuationMutex);
+            ready.swap(counter->continuations);
+        }
+        //The last use of the counter, which may be destroyed right after
+        counter->finishingJobs.fetch_sub(1);
+        for (auto next : ready)
+            push(next);
+    }
+
+    //Own jobs first, newest first, then the oldest job of another worker
+    bool runOneJob(unsigned index)
+    {
+        auto& worker = *workers[index];
+        auto job = worker.deque.pop();
+        if (job == NULL && workers.size() > 1)
+        {
+            //xorshift, so the thieves don't all go after the same victim
+            worker.random ^= worker.random << 13;
+            worker.random ^= worker.random >> 17;
+            worker.random ^= worker.random << 5;
+            auto first = worker.random % workers.size();
+            for (std::size_t i = 0; i < workers.size() && job == NULL; ++i)
+            {
+                auto victim = (first + i) % workers.size();
+                if (victim != index)
+                    job = workers[victim]->deque.steal();
+            }
+        }
+        if (job == NULL)
+            return false;
+        queuedJobs.fetch_sub(1);
+        execute(*job);
+        return true;
+    }
+
+    template <typename Function>
+    void runRange(std::size_t begin, std::size_t end, std::size_t grainSize, const Function* function, JobCounter* counter)
+    {
+        while (end - begin > grainSize)
+        {
+            auto middle = begin + (end - begin) / 2;
+            run([this, middle, end, grainSize, function, counter]()
+            {
+                runRange(middle, end, grainSize, function, counter);
+            }, counter);
+            end = middle;
+        }
+        (*function)(begin, end);
+    }
+
+    //Spins a little when it runs out of jobs, then sleeps until a job is pushed
+    void workerLoop(unsigned index)
+    {
+        getCurrentWorker() = CurrentWorker{this, index};
+        const int spinNumber = 64;
+        int idleNumber = 0;
+        while (!stopping.load(std::memory_order_relaxed))
+        {
+            if (runOneJob(index))
+            {
+                idleNumber = 0;
+                continue;
+            }
+            if (++idleNumber < spinNumber)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleepingWorkers.fetch_add(1);
+            wakeUp.wait(lock, [this]()
+            {
+                return stopping.load() || queuedJobs.load() > 0;
+            });
+            sleepingWorkers.fetch_sub(1);
+            idleNumber = 0;
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<bool> stopping;
+    //Jobs in the deques, so the workers know when to sleep and when to wake up
+    std::atomic<int> queuedJobs;
+    std::atomic<int> sleepingWorkers;
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+};
+
+#endif
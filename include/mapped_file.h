@@ -0,0 +1,168 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//Read-only view of a whole file mapped into memory. The pages are read by the kernel on first
+//access, so there is no read() call and no copy into a user space buffer; parsers like
+//glShaderSource or stbi_load_from_memory read the mapping directly. The data is not
+//null-terminated. The view is valid while the object lives. If the file is truncated while it's
+//mapped, reading past its new end raises SIGBUS, so copy files which may be rewritten at any time
+//instead (see readShaderFile()).
+class MappedFile
+{
+public:
+    MappedFile() :
+        data{NULL}, size{0}, opened{false}
+    {
+    }
+
+    explicit MappedFile(const char* path) :
+        MappedFile()
+    {
+        open(path);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) :
+        data{other.data}, size{other.size}, opened{other.opened}
+    {
+        other.data = NULL;
+        other.size = 0;
+        other.opened = false;
+    }
+
+    MappedFile& operator=(MappedFile&& other)
+    {
+        if (this != &other)
+        {
+            close();
+            data = other.data;
+            size = other.size;
+            opened = other.opened;
+            other.data = NULL;
+            other.size = 0;
+            other.opened = false;
+        }
+        return *this;
+    }
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    //Returns false if the file cannot be opened or mapped
+    bool open(const char* path)
+    {
+        close();
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize))
+        {
+            CloseHandle(file);
+            return false;
+        }
+        size = static_cast<std::size_t>(fileSize.QuadPart);
+        //A mapping of an empty file cannot be created, but it's a valid empty view
+        if (size > 0)
+        {
+            HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping != NULL)
+            {
+                data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                //The view keeps the mapping alive
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(file);
+#else
+        int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+        struct stat status;
+        if (fstat(fd, &status) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        size = static_cast<std::size_t>(status.st_size);
+        if (size > 0)
+        {
+            void* address = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address != MAP_FAILED)
+            {
+                //We read the files from the beginning to the end once, so the kernel can read
+                //ahead aggressively and drop the pages behind us
+                madvise(address, size, MADV_SEQUENTIAL);
+                data = static_cast<const char*>(address);
+            }
+        }
+        //The mapping stays valid after closing the descriptor
+        ::close(fd);
+#endif
+        if (size > 0 && data == NULL)
+        {
+            size = 0;
+            return false;
+        }
+        opened = true;
+        return true;
+    }
+
+    void close()
+    {
+        if (data != NULL)
+        {
+#ifdef _WIN32
+            UnmapViewOfFile(data);
+#else
+            munmap(const_cast<char*>(data), size);
+#endif
+        }
+        data = NULL;
+        size = 0;
+        opened = false;
+    }
+
+    bool isOpen() const
+    {
+        return opened;
+    }
+
+    //NULL for an empty file
+    const char* getData() const
+    {
+        return data;
+    }
+
+    std::size_t getSize() const
+    {
+        return size;
+    }
+
+private:
+    const char* data;
+    std::size_t size;
+    bool opened;
+};
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef MESH_ARENA_H
+#define MESH_ARENA_H
+
+#include <opengl_loader.h>
+#include <range_allocator.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+//Where a mesh lives in a MeshArena
+struct MeshRange
+{
+    GLint baseVertex;
+    GLuint firstIndex;
+    GLsizei vertexCount;
+    GLsizei indexCount;
+};
+
+//Packs many meshes with the same vertex layout into one vertex buffer and one index buffer, so
+//they share a VAO and are drawn with glDrawElementsBaseVertex without binding anything between
+//the draws. The indices of a mesh stay relative to its first vertex, baseVertex is added by the
+//draw. Ranges are managed by a RangeAllocator for the vertices and another for the indices.
+//
+//    MeshArena arena(sizeof(Vertex), 1 << 20, 3 << 20);
+//    glBindVertexArray(arena.getVertexArray());
+//    glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(Vertex), (void*)NULL);
+//    ...
+//    MeshRange cube;
+//    if (arena.allocate(vertices, 24, indices, 36, cube))
+//        arena.draw(cube);
+//    arena.free(cube);
+class MeshArena
+{
+public:
+    struct Stats
+    {
+        RangeAllocator::Stats vertices;
+        RangeAllocator::Stats indices;
+        unsigned allocations;
+        unsigned frees;
+        unsigned failedAllocations;
+        //Time spent in allocate() and free(), including the uploads
+        double allocationMilliseconds;
+    };
+
+    //Requires a current context. The capacities are in vertices and indices.
+    explicit MeshArena(std::size_t vertexStride, std::size_t vertexCapacity, std::size_t indexCapacity) :
+        vertexStride{vertexStride}, vertexAllocator(vertexCapacity), indexAllocator(indexCapacity),
+        stats()
+    {
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        glGenBuffers(1, &ebo);
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertexCapacity * vertexStride), NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indexCapacity * sizeof(GLuint)), NULL, GL_STATIC_DRAW);
+        //Leave the vertex buffer bound, so the caller can set the attributes right away
+        glBindVertexArray(0);
+    }
+
+    MeshArena(const MeshArena&) = delete;
+    MeshArena& operator=(const MeshArena&) = delete;
+
+    ~MeshArena()
+    {
+        if (glfwGetCurrentContext() == NULL)
+            return;
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &vbo);
+        glDeleteBuffers(1, &ebo);
+    }
+
+    //Copies the mesh into the arena. Returns false if there is no room for it. The VAO of the
+    //arena must not be bound to another element buffer meanwhile.
+    bool allocate(const void* vertices, std::size_t vertexCount, const GLuint* indices, std::size_t indexCount, MeshRange& range)
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto vertexOffset = vertexAllocator.allocate(vertexCount);
+        auto indexOffset = indexAllocator.allocate(indexCount);
+        if (vertexOffset == RangeAllocator::invalidOffset || indexOffset == RangeAllocator::invalidOffset)
+        {
+            vertexAllocator.free(vertexOffset, vertexCount);
+            indexAllocator.free(indexOffset, indexCount);
+            ++stats.failedAllocations;
+            addTime(start);
+            return false;
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(vertexOffset * vertexStride),
+            static_cast<GLsizeiptr>(vertexCount * vertexStride), vertices);
+        //The element buffer binding belongs to the VAO, so we use a generic target for the upload
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(indexOffset * sizeof(GLuint)),
+            static_cast<GLsizeiptr>(indexCount * sizeof(GLuint)), indices);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        range.baseVertex = static_cast<GLint>(vertexOffset);
+        range.firstIndex = static_cast<GLuint>(indexOffset);
+        range.vertexCount = static_cast<GLsizei>(vertexCount);
+        range.indexCount = static_cast<GLsizei>(indexCount);
+        ++stats.allocations;
+        addTime(start);
+        return true;
+    }
+
+    void free(MeshRange& range)
+    {
+        if (range.indexCount == 0)
+            return;
+        auto start = std::chrono::steady_clock::now();
+        vertexAllocator.free(static_cast<std::size_t>(range.baseVertex), static_cast<std::size_t>(range.vertexCount));
+        indexAllocator.free(range.firstIndex, static_cast<std::size_t>(range.indexCount));
+        range.vertexCount = range.indexCount = 0;
+        ++stats.frees;
+        addTime(start);
+    }
+
+    //The VAO of the arena must be bound
+    void draw(const MeshRange& range, GLenum mode = GL_TRIANGLES) const
+    {
+        glDrawElementsBaseVertex(mode, range.indexCount, GL_UNSIGNED_INT,
+            reinterpret_cast<void*>(range.firstIndex * sizeof(GLuint)), range.baseVertex);
+    }
+
+    GLuint getVertexArray() const
+    {
+        return vao;
+    }
+
+    GLuint getVertexBuffer() const
+    {
+        return vbo;
+    }
+
+    GLuint getIndexBuffer() const
+    {
+        return ebo;
+    }
+
+    Stats getStats() const
+    {
+        Stats result = stats;
+        result.vertices = vertexAllocator.getStats();
+        result.indices = indexAllocator.getStats();
+        return result;
+    }
+
+    //The worse of the vertex and index fragmentation, see RangeAllocator::getFragmentation()
+    double getFragmentation() const
+    {
+        auto vertexFragmentation = vertexAllocator.getFragmentation();
+        auto indexFragmentation = indexAllocator.getFragmentation();
+        return vertexFragmentation > indexFragmentation ? vertexFragmentation : indexFragmentation;
+    }
+
+private:
+    void addTime(std::chrono::steady_clock::time_point start)
+    {
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        stats.allocationMilliseconds += elapsed.count();
+    }
+
+private:
+    std::size_t vertexStride;
+    RangeAllocator vertexAllocator, indexAllocator;
+    GLuint vao, vbo, ebo;
+    Stats stats;
+};
+
+#endif
@@ -0,0 +1,337 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <opengl_loader.h>
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+//Reorders indexed triangle lists so the GPU runs the vertex shader fewer times and reads the
+//vertex buffer in order. The usual pipeline is weldVertices, optimizeVertexCache,
+//optimizeOverdraw and optimizeVertexFetch, optimizeMesh() does the last three. They can run
+//when a mesh is loaded, since they are close to linear in the number of triangles.
+
+struct VertexCacheStats
+{
+    //Vertex shader invocations with a FIFO post-transform cache
+    std::size_t transformedVertices;
+    //Average cache miss ratio: invocations per triangle. 3 is the worst, 0.5 is the best for
+    //a large grid.
+    double acmr;
+    //Average transform to vertex ratio: invocations per vertex. 1 is the best.
+    double atvr;
+};
+
+//Simulates a FIFO cache of cacheSize vertices, which is close to what GPUs do
+inline VertexCacheStats analyzeVertexCache(const GLuint* indices, std::size_t indexCount, std::size_t vertexCount,
+    std::size_t cacheSize = 16)
+{
+    //A vertex is in the cache if fewer than cacheSize vertices were added after it
+    std::vector<std::size_t> addedAt(vertexCount, 0);
+    std::size_t time = cacheSize + 1;
+    VertexCacheStats stats = {0, 0.0, 0.0};
+    for (std::size_t i = 0; i < indexCount; ++i)
+    {
+        auto vertex = indices[i];
+        if (time - addedAt[vertex] > cacheSize)
+        {
+            addedAt[vertex] = time++;
+            ++stats.transformedVertices;
+        }
+    }
+    if (indexCount >= 3)
+        stats.acmr = static_cast<double>(stats.transformedVertices) / (indexCount / 3);
+    if (vertexCount > 0)
+        stats.atvr = static_cast<double>(stats.transformedVertices) / vertexCount;
+    return stats;
+}
+
+//The LRU cache simulated by optimizeVertexCache. It's larger than the FIFO caches of GPUs, an
+//order which is good for it is good for any smaller cache.
+const int forsythCacheSize = 32;
+const int forsythMaxValence = 32;
+
+//Tom Forsyth's "Linear-Speed Vertex Cache Optimisation": greedily emits the triangle with the
+//highest score, where a vertex scores high if it's recently used (but not in the last
+//triangle, which would make strips) or has few triangles left, so no vertex is left behind
+//with a lonely triangle. Returns the reordered indices.
+inline std::vector<GLuint> optimizeVertexCache(const GLuint* indices, std::size_t indexCount, std::size_t vertexCount)
+{
+    float cacheScores[forsythCacheSize];
+    for (int i = 0; i < forsythCacheSize; ++i)
+        cacheScores[i] = i < 3 ? 0.75f : std::pow(1.0f - static_cast<float>(i - 3) / (forsythCacheSize - 3), 1.5f);
+    float valenceScores[forsythMaxValence + 1];
+    valenceScores[0] = 0.0f;
+    for (int i = 1; i <= forsythMaxValence; ++i)
+        valenceScores[i] = 2.0f / std::sqrt(static_cast<float>(i));
+    auto getVertexScore = [&](int cachePosition, std::uint32_t remaining)
+    {
+        if (remaining == 0)
+            return -1.0f;
+        float score = cachePosition >= 0 ? cacheScores[cachePosition] : 0.0f;
+        return score + (remaining <= forsythMaxValence ? valenceScores[remaining] : 2.0f / std::sqrt(static_cast<float>(remaining)));
+    };
+
+    //The triangles of each vertex, with the remaining ones at the front of the range
+    auto triangleCount = indexCount / 3;
+    std::vector<std::uint32_t> remaining(vertexCount, 0);
+    for (std::size_t i = 0; i < triangleCount * 3; ++i)
+        ++remaining[indices[i]];
+    std::vector<std::size_t> firstTriangle(vertexCount + 1, 0);
+    for (std::size_t v = 0; v < vertexCount; ++v)
+        firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+    std::vector<std::uint32_t> triangles(triangleCount * 3);
+    {
+        std::vector<std::size_t> cursor(firstTriangle.begin(), firstTriangle.end() - 1);
+        for (std::size_t i = 0; i < triangleCount * 3; ++i)
+            triangles[cursor[indices[i]]++] = static_cast<std::uint32_t>(i / 3);
+    }
+
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (std::size_t v = 0; v < vertexCount; ++v)
+        vertexScores[v] = getVertexScore(-1, remaining[v]);
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    std::size_t best = triangleCount;
+    for (std::size_t t = 0; t < triangleCount; ++t)
+    {
+        const GLuint* triangle = indices + t * 3;
+        triangleScores[t] = vertexScores[triangle[0]] + vertexScores[triangle[1]] + vertexScores[triangle[2]];
+        if (best == triangleCount || triangleScores[t] > triangleScores[best])
+            best = t;
+    }
+
+    std::vector<GLuint> result;
+    result.reserve(triangleCount * 3);
+    GLuint cache[forsythCacheSize + 3];
+    int cacheCount = 0;
+    std::size_t nextUnemitted = 0;
+    while (result.size() < triangleCount * 3)
+    {
+        //No triangle around the cache is left, take the next one in the input order
+        if (best == triangleCount)
+        {
+            while (emitted[nextUnemitted])
+                ++nextUnemitted;
+            best = nextUnemitted;
+        }
+        const GLuint* triangle = indices + best * 3;
+        result.insert(result.end(), triangle, triangle + 3);
+        emitted[best] = true;
+
+        GLuint newCache[forsythCacheSize + 3];
+        int newCacheCount = 0;
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            auto vertex = triangle[corner];
+            //Move the triangle to the end of the remaining ones of the vertex
+            auto begin = triangles.begin() + firstTriangle[vertex];
+            auto end = begin + remaining[vertex];
+            auto it = std::find(begin, end, static_cast<std::uint32_t>(best));
+            if (it != end)
+            {
+                std::iter_swap(it, end - 1);
+                --remaining[vertex];
+            }
+            if (std::find(newCache, newCache + newCacheCount, vertex) == newCache + newCacheCount)
+                newCache[newCacheCount++] = vertex;
+        }
+        auto triangleEnd = newCache + newCacheCount;
+        for (int i = 0; i < cacheCount; ++i)
+        {
+            if (std::find(newCache, triangleEnd, cache[i]) == triangleEnd)
+                newCache[newCacheCount++] = cache[i];
+        }
+
+        //The vertices which were pushed out of the cache are updated too
+        for (int i = 0; i < newCacheCount; ++i)
+        {
+            auto vertex = newCache[i];
+            cachePositions[vertex] = i < forsythCacheSize ? i : -1;
+            vertexScores[vertex] = getVertexScore(cachePositions[vertex], remaining[vertex]);
+        }
+        best = triangleCount;
+        for (int i = 0; i < newCacheCount; ++i)
+        {
+            auto vertex = newCache[i];
+            for (std::size_t j = firstTriangle[vertex]; j < firstTriangle[vertex] + remaining[vertex]; ++j)
+            {
+                auto t = triangles[j];
+                const GLuint* other = indices + static_cast<std::size_t>(t) * 3;
+                triangleScores[t] = vertexScores[other[0]] + vertexScores[other[1]] + vertexScores[other[2]];
+                if (best == triangleCount || triangleScores[t] > triangleScores[best])
+                    best = t;
+            }
+        }
+        cacheCount = std::min(newCacheCount, forsythCacheSize);
+        std::copy(newCache, newCache + cacheCount, cache);
+    }
+    return result;
+}
+
+//Pedro Sander's "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw": the
+//cache-optimized order is cut into clusters, which are drawn outward-facing first, so with the
+//depth test the triangles behind them are rejected before shading. A cluster starts where
+//all the vertices of a triangle are cache misses, or where the cluster so far, starting with
+//an empty cache, has an ACMR within threshold of the whole mesh. So the ACMR gets at most
+//about threshold times worse.
+//positions points to the first vertex's position (3 floats), stride is the size of a
+//vertex. Front faces are counter-clockwise, like OpenGL's default.
+inline void optimizeOverdraw(std::vector<GLuint>& indices, const GLfloat* positions, std::size_t stride,
+    std::size_t vertexCount, double threshold = 1.05, std::size_t cacheSize = 16)
+{
+    auto triangleCount = indices.size() / 3;
+    if (triangleCount < 2)
+        return;
+    auto meshAcmr = analyzeVertexCache(indices.data(), indices.size(), vertexCount, cacheSize).acmr;
+
+    //The cache is flushed at the start of each cluster, since the cluster before it in the new
+    //order is a different one
+    std::vector<std::size_t> clusterStarts;
+    {
+        std::vector<std::size_t> addedAt(vertexCount, 0);
+        std::size_t time = cacheSize + 1;
+        auto simulate = [&](std::size_t t)
+        {
+            int misses = 0;
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                auto vertex = indices[t * 3 + corner];
+                if (time - addedAt[vertex] > cacheSize)
+                {
+                    addedAt[vertex] = time++;
+                    ++misses;
+                }
+            }
+            return misses;
+        };
+        std::size_t clusterMisses = 0, clusterTriangles = 0;
+        for (std::size_t t = 0; t < triangleCount; ++t)
+        {
+            auto misses = simulate(t);
+            bool softBoundary = clusterTriangles > 0 &&
+                static_cast<double>(clusterMisses) / clusterTriangles <= threshold * meshAcmr;
+            if (t == 0 || misses == 3 || softBoundary)
+            {
+                if (misses < 3)
+                {
+                    time += cacheSize + 1;
+                    misses = simulate(t);
+                }
+                clusterStarts.push_back(t);
+                clusterMisses = 0;
+                clusterTriangles = 0;
+            }
+            clusterMisses += misses;
+            ++clusterTriangles;
+        }
+    }
+    clusterStarts.push_back(triangleCount);
+
+    auto getPosition = [&](GLuint vertex)
+    {
+        return reinterpret_cast<const GLfloat*>(reinterpret_cast<const unsigned char*>(positions) + vertex * stride);
+    };
+    //Area-weighted centroid and normal of each cluster
+    auto clusterCount = clusterStarts.size() - 1;
+    std::vector<double> centroids(clusterCount * 3, 0.0), normals(clusterCount * 3, 0.0), areas(clusterCount, 0.0);
+    double meshCentroid[3] = {0.0, 0.0, 0.0};
+    double meshArea = 0.0;
+    for (std::size_t c = 0; c < clusterCount; ++c)
+    {
+        for (auto t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t)
+        {
+            auto a = getPosition(indices[t * 3]), b = getPosition(indices[t * 3 + 1]), d = getPosition(indices[t * 3 + 2]);
+            double ab[3], ad[3];
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                ab[axis] = b[axis] - a[axis];
+                ad[axis] = d[axis] - a[axis];
+            }
+            double normal[3] = {ab[1] * ad[2] - ab[2] * ad[1], ab[2] * ad[0] - ab[0] * ad[2], ab[0] * ad[1] - ab[1] * ad[0]};
+            auto area = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                auto center = (a[axis] + b[axis] + d[axis]) / 3.0;
+                centroids[c * 3 + axis] += center * area;
+                normals[c * 3 + axis] += normal[axis];
+                meshCentroid[axis] += center * area;
+            }
+            areas[c] += area;
+            meshArea += area;
+        }
+    }
+    if (meshArea > 0.0)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+            meshCentroid[axis] /= meshArea;
+    }
+
+    std::vector<double> keys(clusterCount, 0.0);
+    for (std::size_t c = 0; c < clusterCount; ++c)
+    {
+        if (areas[c] <= 0.0)
+            continue;
+        double length = std::sqrt(normals[c * 3] * normals[c * 3] + normals[c * 3 + 1] * normals[c * 3 + 1] +
+            normals[c * 3 + 2] * normals[c * 3 + 2]);
+        if (length <= 0.0)
+            continue;
+        for (int axis = 0; axis < 3; ++axis)
+            keys[c] += (centroids[c * 3 + axis] / areas[c] - meshCentroid[axis]) * normals[c * 3 + axis] / length;
+    }
+
+    std::vector<std::size_t> order(clusterCount);
+    for (std::size_t c = 0; c < clusterCount; ++c)
+        order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&keys](std::size_t a, std::size_t b)
+    {
+        return keys[a] > keys[b];
+    });
+
+    std::vector<GLuint> result;
+    result.reserve(indices.size());
+    for (auto c : order)
+        result.insert(result.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+    indices.swap(result);
+}
+
+//Renumbers the vertices in the order the indices first use them, so the vertex fetch reads
+//the buffer mostly sequentially. Unused vertices are dropped. Returns the new vertex count.
+inline std::size_t optimizeVertexFetch(void* vertices, std::size_t vertexCount, std::size_t stride, GLuint* indices,
+    std::size_t indexCount)
+{
+    const GLuint unused = static_cast<GLuint>(-1);
+    std::vector<GLuint> remap(vertexCount, unused);
+    std::vector<unsigned char> source(static_cast<unsigned char*>(vertices), static_cast<unsigned char*>(vertices) + vertexCount * stride);
+    auto target = static_cast<unsigned char*>(vertices);
+    GLuint nextVertex = 0;
+    for (std::size_t i = 0; i < indexCount; ++i)
+    {
+        auto& newIndex = remap[indices[i]];
+        if (newIndex == unused)
+        {
+            std::memcpy(target + static_cast<std::size_t>(nextVertex) * stride, source.data() + static_cast<std::size_t>(indices[i]) * stride, stride);
+            newIndex = nextVertex++;
+        }
+        indices[i] = newIndex;
+    }
+    return nextVertex;
+}
+
+//Runs the three passes on a mesh with a GLfloat position[3] member, e.g. FloatVertex
+template <typename Vertex>
+void optimizeMesh(std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+{
+    if (vertices.empty() || indices.empty())
+        return;
+    indices = optimizeVertexCache(indices.data(), indices.size(), vertices.size());
+    optimizeOverdraw(indices, vertices[0].position, sizeof(Vertex), vertices.size());
+    vertices.resize(optimizeVertexFetch(vertices.data(), vertices.size(), sizeof(Vertex), indices.data(), indices.size()));
+}
+
+#endif
@@ -0,0 +1,372 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <bvh.h>
+#include <job_system.h>
+
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_CULLER_SSE
+#endif
+
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+//Hierarchical-Z occlusion culling on the CPU. A few large occluders are rasterized into a small
+//depth buffer, a max-depth mip pyramid is built from it, and the bounding boxes of the
+//instances are tested against the pyramid before they are submitted. An instance is culled
+//only if it's certainly hidden: an occluder writes a pixel only if it covers all of it, with
+//the farthest depth it has in the pixel, so the buffer is never in front of the occluders.
+//The results don't depend on the number of threads.
+//
+//    culler.beginFrame(projection * view);
+//    culler.addOccluder(wallVertices, 4, wallIndices, 6, wallModel);
+//    culler.rasterize(jobs);
+//    if (culler.isVisible(bounds)) ...
+class OcclusionCuller
+{
+public:
+    struct Stats
+    {
+        std::size_t occluderTriangles;
+        std::size_t testedInstances;
+        std::size_t occludedInstances;
+    };
+
+    //The width is rounded up to a multiple of 4 for the SIMD rasterizer
+    OcclusionCuller(int width = 256, int height = 128) :
+        width{(width + 3) / 4 * 4},
+        height{height},
+        stats{0, 0, 0}
+    {
+        int levelWidth = this->width, levelHeight = this->height;
+        for (;;)
+        {
+            levels.push_back(Level{levelWidth, levelHeight, std::vector<float>(static_cast<std::size_t>(levelWidth) * levelHeight, 1.0f)});
+            if (levelWidth == 1 && levelHeight == 1)
+                break;
+            levelWidth = std::max(1, (levelWidth + 1) / 2);
+            levelHeight = std::max(1, (levelHeight + 1) / 2);
+        }
+    }
+
+    void beginFrame(const glm::mat4& viewProjection)
+    {
+        viewProj = viewProjection;
+        triangles.clear();
+        std::fill(levels[0].depths.begin(), levels[0].depths.end(), 1.0f);
+        stats = Stats{0, 0, 0};
+    }
+
+    //Transforms the triangles of an occluder to screen space. Triangles which cross the near
+    //plane are skipped, which only makes the culling less aggressive.
+    void addOccluder(const glm::vec3* positions, std::size_t vertexCount, const std::uint32_t* indices, std::size_t indexCount,
+        const glm::mat4& model)
+    {
+        auto modelViewProj = viewProj * model;
+        std::vector<ScreenVertex> screen(vertexCount);
+        for (std::size_t i = 0; i < vertexCount; ++i)
+            screen[i] = project(modelViewProj, positions[i]);
+        for (std::size_t i = 0; i + 2 < indexCount; i += 3)
+        {
+            const ScreenVertex* corners[3] = {&screen[indices[i]], &screen[indices[i + 1]], &screen[indices[i + 2]]};
+            if (!corners[0]->valid || !corners[1]->valid || !corners[2]->valid)
+                continue;
+            Triangle triangle;
+            if (setupTriangle(corners, triangle))
+                triangles.push_back(triangle);
+        }
+    }
+
+    //Rasterizes the occluders and builds the pyramid
+    void rasterize()
+    {
+        rasterizeBand(0, height);
+        finishRasterize();
+    }
+
+    //Like rasterize(), on the workers of jobs. The rows are split in bands, one per job and one
+    //job per worker, so every pixel is written by one job. It must be called by one of the
+    //workers.
+    void rasterize(JobSystem& jobs)
+    {
+        auto bandNumber = std::min(jobs.getThreadNumber(), static_cast<unsigned>(height));
+        if (bandNumber <= 1)
+        {
+            rasterize();
+            return;
+        }
+        int bandHeight = (height + static_cast<int>(bandNumber) - 1) / static_cast<int>(bandNumber);
+        jobs.parallelFor(0, bandNumber, 1, [&](std::size_t begin, std::size_t end)
+        {
+            for (auto band = begin; band < end; ++band)
+            {
+                int top = static_cast<int>(band) * bandHeight;
+                rasterizeBand(std::min(height, top), std::min(height, top + bandHeight));
+            }
+        });
+        finishRasterize();
+    }
+
+    //False if the box is certainly hidden behind the occluders or outside of the screen
+    bool isVisible(const Aabb& box)
+    {
+        ++stats.testedInstances;
+        float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, nearest = 1e30f;
+        for (int corner = 0; corner < 8; ++corner)
+        {
+            glm::vec3 position(box.min[0], box.min[1], box.min[2]);
+            if (corner & 1)
+                position.x = box.max[0];
+            if (corner & 2)
+                position.y = box.max[1];
+            if (corner & 4)
+                position.z = box.max[2];
+            auto vertex = project(viewProj, position);
+            //The box reaches behind the camera
+            if (!vertex.valid)
+                return true;
+            minX = std::min(minX, vertex.x);
+            maxX = std::max(maxX, vertex.x);
+            minY = std::min(minY, vertex.y);
+            maxY = std::max(maxY, vertex.y);
+            nearest = std::min(nearest, vertex.z);
+        }
+        if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height || nearest > 1.0f)
+        {
+            ++stats.occludedInstances;
+            return false;
+        }
+        if (nearest < 0.0f)
+            return true;
+
+        //The level where the rectangle covers at most 2x2 texels, plus one for the rounding
+        minX = std::max(minX, 0.0f);
+        minY = std::max(minY, 0.0f);
+        maxX = std::min(maxX, static_cast<float>(width - 1));
+        maxY = std::min(maxY, static_cast<float>(height - 1));
+        float size = std::max(maxX - minX, maxY - minY);
+        int level = 0;
+        while (level + 1 < static_cast<int>(levels.size()) && size > 2.0f)
+        {
+            size *= 0.5f;
+            ++level;
+        }
+        const auto& mip = levels[level];
+        int x0 = static_cast<int>(minX) >> level, x1 = static_cast<int>(maxX) >> level;
+        int y0 = static_cast<int>(minY) >> level, y1 = static_cast<int>(maxY) >> level;
+        for (int y = y0; y <= y1; ++y)
+        {
+            for (int x = x0; x <= x1; ++x)
+            {
+                if (nearest <= mip.depths[static_cast<std::size_t>(y) * mip.width + x])
+                    return true;
+            }
+        }
+        ++stats.occludedInstances;
+        return false;
+    }
+
+    //Writes the indices of the boxes which may be visible to visible, in order
+    void cull(const Aabb* boxes, std::size_t boxNumber, std::vector<std::uint32_t>& visible)
+    {
+        visible.clear();
+        for (std::size_t i = 0; i < boxNumber; ++i)
+        {
+            if (isVisible(boxes[i]))
+                visible.push_back(static_cast<std::uint32_t>(i));
+        }
+    }
+
+    int getWidth() const
+    {
+        return width;
+    }
+
+    int getHeight() const
+    {
+        return height;
+    }
+
+    std::size_t getLevelNumber() const
+    {
+        return levels.size();
+    }
+
+    //Depths in [0, 1], 1 is the far plane. Level 0 is the rasterized buffer, row by row from the
+    //bottom.
+    const std::vector<float>& getDepths(std::size_t level = 0) const
+    {
+        return levels[level].depths;
+    }
+
+    Stats getStats() const
+    {
+        return stats;
+    }
+
+private:
+    struct ScreenVertex
+    {
+        float x, y, z;
+        bool valid;
+    };
+
+    //The edge functions a * x + b * y + c, which are >= 0 inside, and the depth plane
+    struct Triangle
+    {
+        float a[3], b[3], c[3];
+        float depthX, depthY, depthC;
+        int minX, maxX, minY, maxY;
+    };
+
+    struct Level
+    {
+        int width, height;
+        std::vector<float> depths;
+    };
+
+    ScreenVertex project(const glm::mat4& matrix, const glm::vec3& position) const
+    {
+        float clip[4];
+        for (int row = 0; row < 4; ++row)
+            clip[row] = matrix[0][row] * position.x + matrix[1][row] * position.y + matrix[2][row] * position.z + matrix[3][row];
+        ScreenVertex vertex;
+        //In front of the near plane: z >= -w
+        vertex.valid = clip[3] > 1e-6f && clip[2] >= -clip[3];
+        if (!vertex.valid)
+            return vertex;
+        float inverseW = 1.0f / clip[3];
+        vertex.x = (clip[0] * inverseW * 0.5f + 0.5f) * width;
+        vertex.y = (clip[1] * inverseW * 0.5f + 0.5f) * height;
+        vertex.z = clip[2] * inverseW * 0.5f + 0.5f;
+        return vertex;
+    }
+
+    bool setupTriangle(const ScreenVertex* corners[3], Triangle& triangle) const
+    {
+        const auto& v0 = *corners[0];
+        const auto& v1 = *corners[1];
+        const auto& v2 = *corners[2];
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+        if (std::fabs(area) < 1e-8f)
+            return false;
+        //Both windings, so it doesn't matter how the occluder is wound
+        float sign = area > 0.0f ? 1.0f : -1.0f;
+        const ScreenVertex* edges[3][2] = {{&v1, &v2}, {&v2, &v0}, {&v0, &v1}};
+        for (int e = 0; e < 3; ++e)
+        {
+            const auto& from = *edges[e][0];
+            const auto& to = *edges[e][1];
+            triangle.a[e] = sign * (from.y - to.y);
+            triangle.b[e] = sign * (to.x - from.x);
+            triangle.c[e] = sign * (from.x * to.y - to.x * from.y);
+            //Evaluated at the pixel center, the edge function is at least this much lower
+            //somewhere in the pixel. Subtracting it tests the whole pixel.
+            triangle.c[e] -= (std::fabs(triangle.a[e]) + std::fabs(triangle.b[e])) * 0.5f;
+        }
+        //z = depthX * x + depthY * y + depthC, plus the most it grows within half a pixel
+        triangle.depthX = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+        triangle.depthY = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+        triangle.depthC = v0.z - triangle.depthX * v0.x - triangle.depthY * v0.y +
+            (std::fabs(triangle.depthX) + std::fabs(triangle.depthY)) * 0.5f;
+
+        triangle.minX = std::max(0, static_cast<int>(std::floor(std::min(v0.x, std::min(v1.x, v2.x)))));
+        triangle.maxX = std::min(width - 1, static_cast<int>(std::ceil(std::max(v0.x, std::max(v1.x, v2.x)))));
+        triangle.minY = std::max(0, static_cast<int>(std::floor(std::min(v0.y, std::min(v1.y, v2.y)))));
+        triangle.maxY = std::min(height - 1, static_cast<int>(std::ceil(std::max(v0.y, std::max(v1.y, v2.y)))));
+        return triangle.minX <= triangle.maxX && triangle.minY <= triangle.maxY;
+    }
+
+    void rasterizeBand(int top, int bottom)
+    {
+        auto& depths = levels[0].depths;
+        for (const auto& triangle : triangles)
+        {
+            int minY = std::max(top, triangle.minY), maxY = std::min(bottom - 1, triangle.maxY);
+            //4 pixels at a time from a multiple of 4, the width is one too
+            int minX = triangle.minX & ~3;
+            for (int y = minY; y <= maxY; ++y)
+            {
+                float centerY = y + 0.5f;
+                float* row = &depths[static_cast<std::size_t>(y) * width];
+#if defined(OCCLUSION_CULLER_SSE)
+                __m128 rowEdges[3], stepX[3];
+                for (int e = 0; e < 3; ++e)
+                {
+                    rowEdges[e] = _mm_set1_ps(triangle.b[e] * centerY + triangle.c[e]);
+                    stepX[e] = _mm_set1_ps(triangle.a[e]);
+                }
+                auto rowDepth = _mm_set1_ps(triangle.depthY * centerY + triangle.depthC);
+                auto depthStepX = _mm_set1_ps(triangle.depthX);
+                for (int x = minX; x <= triangle.maxX; x += 4)
+                {
+                    auto centerX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+                    auto inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(stepX[0], centerX), rowEdges[0]), _mm_setzero_ps());
+                    for (int e = 1; e < 3; ++e)
+                        inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(stepX[e], centerX), rowEdges[e]), _mm_setzero_ps()));
+                    if (_mm_movemask_ps(inside) == 0)
+                        continue;
+                    auto depth = _mm_add_ps(_mm_mul_ps(depthStepX, centerX), rowDepth);
+                    auto old = _mm_loadu_ps(row + x);
+                    auto nearer = _mm_min_ps(old, depth);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+                }
+#else
+                for (int x = minX; x <= triangle.maxX; ++x)
+                {
+                    float centerX = x + 0.5f;
+                    bool inside = true;
+                    for (int e = 0; e < 3; ++e)
+                        inside &= triangle.a[e] * centerX + (triangle.b[e] * centerY + triangle.c[e]) >= 0.0f;
+                    if (!inside)
+                        continue;
+                    float depth = triangle.depthX * centerX + (triangle.depthY * centerY + triangle.depthC);
+                    row[x] = std::min(row[x], depth);
+                }
+#endif
+            }
+        }
+    }
+
+    void finishRasterize()
+    {
+        stats.occluderTriangles = triangles.size();
+        buildPyramid();
+    }
+
+    //Each texel is the farthest of the 2x2 (or fewer at the border) texels below it
+    void buildPyramid()
+    {
+        for (std::size_t level = 1; level < levels.size(); ++level)
+        {
+            const auto& source = levels[level - 1];
+            auto& target = levels[level];
+            for (int y = 0; y < target.height; ++y)
+            {
+                int sourceY0 = std::min(y * 2, source.height - 1), sourceY1 = std::min(y * 2 + 1, source.height - 1);
+                for (int x = 0; x < target.width; ++x)
+                {
+                    int sourceX0 = std::min(x * 2, source.width - 1), sourceX1 = std::min(x * 2 + 1, source.width - 1);
+                    const float* row0 = &source.depths[static_cast<std::size_t>(sourceY0) * source.width];
+                    const float* row1 = &source.depths[static_cast<std::size_t>(sourceY1) * source.width];
+                    target.depths[static_cast<std::size_t>(y) * target.width + x] =
+                        std::max(std::max(row0[sourceX0], row0[sourceX1]), std::max(row1[sourceX0], row1[sourceX1]));
+                }
+            }
+        }
+    }
+
+    int width, height;
+    glm::mat4 viewProj;
+    std::vector<Triangle> triangles;
+    std::vector<Level> levels;
+    Stats stats;
+};
+
+#endif
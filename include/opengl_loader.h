@@ -1,6 +1,8 @@
 #ifndef OPENGL_LOADER_H
 #define OPENGL_LOADER_H
 
+#include <cstring>
+
 #ifdef USE_GLBINDING
 
 #include <glbinding/gl/gl.h>
@@ -9,6 +11,7 @@
 using namespace gl;
 
 #define GLFW_INCLUDE_NONE 
+#include <GLFW/glfw3.h>
 
 #endif
 
@@ -17,20 +20,152 @@ using namespace gl;
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+//Our glad loader is generated for core 3.3 without any extension. Entry points of newer
+//versions are loaded by hand in loadOpenGLExtensions() and stay NULL if the driver doesn't
+//provide them, so always check for support before calling them.
+
+#ifndef GL_VERSION_4_1
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+static PFNGLGETPROGRAMBINARYPROC glad_glGetProgramBinary = NULL;
+static PFNGLPROGRAMBINARYPROC glad_glProgramBinary = NULL;
+static PFNGLPROGRAMPARAMETERIPROC glad_glProgramParameteri = NULL;
+
+#define glGetProgramBinary glad_glGetProgramBinary
+#define glProgramBinary glad_glProgramBinary
+#define glProgramParameteri glad_glProgramParameteri
+#endif
+
+#ifndef GL_VERSION_4_2
+typedef void (APIENTRYP PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXBASEINSTANCEPROC)(GLenum mode, GLsizei count, GLenum type, const void* indices,
+    GLsizei instancecount, GLint basevertex, GLuint baseinstance);
+
+static PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXBASEINSTANCEPROC glad_glDrawElementsInstancedBaseVertexBaseInstance = NULL;
+
+#define glDrawElementsInstancedBaseVertexBaseInstance glad_glDrawElementsInstancedBaseVertexBaseInstance
+#endif
+
+#ifndef GL_VERSION_4_3
+#define GL_PRIMITIVE_RESTART_FIXED_INDEX 0x8D69
 #endif
 
+#ifndef GL_VERSION_4_4
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+static PFNGLBUFFERSTORAGEPROC glad_glBufferStorage = NULL;
+
+#define glBufferStorage glad_glBufferStorage
+#endif
+
+inline void loadOpenGLExtensions()
+{
+#ifndef GL_VERSION_4_1
+    glad_glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)glfwGetProcAddress("glGetProgramBinary");
+    glad_glProgramBinary = (PFNGLPROGRAMBINARYPROC)glfwGetProcAddress("glProgramBinary");
+    glad_glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)glfwGetProcAddress("glProgramParameteri");
+#endif
+#ifndef GL_VERSION_4_2
+    //GL_ARB_base_instance uses the same name
+    glad_glDrawElementsInstancedBaseVertexBaseInstance = (PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXBASEINSTANCEPROC)glfwGetProcAddress(
+        "glDrawElementsInstancedBaseVertexBaseInstance");
+#endif
+#ifndef GL_VERSION_4_4
+    //GL_ARB_buffer_storage uses the same name
+    glad_glBufferStorage = (PFNGLBUFFERSTORAGEPROC)glfwGetProcAddress("glBufferStorage");
+#endif
+}
+
+#endif
+
+inline bool isOpenGLVersionAtLeast(int major, int minor)
+{
+    GLint currentMajor = 0, currentMinor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &currentMajor);
+    glGetIntegerv(GL_MINOR_VERSION, &currentMinor);
+    return currentMajor > major || (currentMajor == major && currentMinor >= minor);
+}
+
+inline bool isOpenGLExtensionSupported(const char* name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i)
+    {
+        auto extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+        if (extension != NULL && std::strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+//GL_PRIMITIVE_RESTART_FIXED_INDEX restarts at the largest value of the index type of each draw,
+//so there is no restart index to set
+inline bool isFixedIndexPrimitiveRestartSupported()
+{
+    return isOpenGLVersionAtLeast(4, 3) || isOpenGLExtensionSupported("GL_ARB_ES3_compatibility");
+}
+
+//Extensions that our loaders don't know about. They are loaded through GLFW in both paths.
+//Some platforms return an address even for unsupported functions, so check the is*Supported()
+//function of the extension before using it.
+
+#ifdef _WIN32
+#define GLEXT_APIENTRY __stdcall
+#else
+#define GLEXT_APIENTRY
+#endif
+
+//GL_KHR_parallel_shader_compile (or GL_ARB_parallel_shader_compile)
+const GLenum GLEXT_COMPLETION_STATUS = static_cast<GLenum>(0x91B1);
+typedef void (GLEXT_APIENTRY* PFNGLEXTMAXSHADERCOMPILERTHREADSPROC)(GLuint count);
+static PFNGLEXTMAXSHADERCOMPILERTHREADSPROC glextMaxShaderCompilerThreads = NULL;
+static bool glextParallelShaderCompile = false;
+
+inline bool isParallelShaderCompileSupported()
+{
+    return glextParallelShaderCompile;
+}
+
+inline void loadOpenGLVendorExtensions()
+{
+    glextParallelShaderCompile = isOpenGLExtensionSupported("GL_KHR_parallel_shader_compile") ||
+                                 isOpenGLExtensionSupported("GL_ARB_parallel_shader_compile");
+    glextMaxShaderCompilerThreads = reinterpret_cast<PFNGLEXTMAXSHADERCOMPILERTHREADSPROC>(glfwGetProcAddress("glMaxShaderCompilerThreadsKHR"));
+    if (glextMaxShaderCompilerThreads == NULL)
+        glextMaxShaderCompilerThreads = reinterpret_cast<PFNGLEXTMAXSHADERCOMPILERTHREADSPROC>(glfwGetProcAddress("glMaxShaderCompilerThreadsARB"));
+    if (glextMaxShaderCompilerThreads == NULL)
+        glextParallelShaderCompile = false;
+}
+
 bool loadOpenGL()
 {
 #ifdef USE_GLBINDING
     
     glbinding::Binding::initialize();
+    loadOpenGLVendorExtensions();
     return true;
     
 #endif
 
 #ifdef USE_GLAD
     
-    return gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+        return false;
+    loadOpenGLExtensions();
+    loadOpenGLVendorExtensions();
+    return true;
     
 #endif
 }
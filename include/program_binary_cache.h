@@ -0,0 +1,190 @@
+#ifndef PROGRAM_BINARY_CACHE_H
+#define PROGRAM_BINARY_CACHE_H
+
+#include <opengl_loader.h>
+#include <hash.h>
+#include <shader_source.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cerrno>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+//Stores linked programs on disk with glGetProgramBinary and restores them with glProgramBinary,
+//so we don't compile and link the same shaders on each run. A binary is only valid for the
+//driver that produced it, so the key includes the vendor, renderer and version strings besides
+//the shader sources. If the driver rejects a cached binary (e.g. after a driver update with the
+//same version string), the entry is removed and the caller should build the program from source.
+//
+//The cache directory can be changed through LEARNOPENGL_SHADER_CACHE environment variable.
+class ProgramBinaryCache
+{
+public:
+    explicit ProgramBinaryCache(const std::string& directory = defaultDirectory()) :
+        directory{directory}
+    {
+    }
+
+    static std::string defaultDirectory()
+    {
+        const char* dir = std::getenv("LEARNOPENGL_SHADER_CACHE");
+        return dir != NULL && *dir != '\0' ? dir : "shader_cache";
+    }
+
+    //Requires a current context
+    static bool isSupported()
+    {
+        if (!isOpenGLVersionAtLeast(4, 1) && !isOpenGLExtensionSupported("GL_ARB_get_program_binary"))
+            return false;
+#ifdef USE_GLAD
+        if (glGetProgramBinary == NULL || glProgramBinary == NULL || glProgramParameteri == NULL)
+            return false;
+#endif
+        GLint formatNumber = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatNumber);
+        return formatNumber > 0;
+    }
+
+    //Requires a current context
+    static std::string makeKey(ShaderSource vertexCode, ShaderSource fragmentCode, const std::string& defines = "")
+    {
+        auto hash = fnv1a(vertexCode.data, vertexCode.size);
+        hash = fnv1a(&vertexCode.size, sizeof(vertexCode.size), hash);
+        hash = fnv1a(fragmentCode.data, fragmentCode.size, hash);
+        hash = fnv1a(&fragmentCode.size, sizeof(fragmentCode.size), hash);
+        hash = fnv1a(defines, hash);
+        hash = fnv1a(getString(GL_VENDOR), hash);
+        hash = fnv1a(getString(GL_RENDERER), hash);
+        hash = fnv1a(getString(GL_VERSION), hash);
+        return toHexString(hash);
+    }
+
+    //Must be called before linking a program we want to store later
+    static void setRetrievableHint(GLuint programId)
+    {
+        glProgramParameteri(programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, 1);
+    }
+
+    //Returns true if programId is linked from the cached binary
+    bool load(GLuint programId, const std::string& key)
+    {
+        std::ifstream file(getPath(key).c_str(), std::ios::binary);
+        if (!file)
+            return false;
+
+        Header header;
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+            header.magic != magicNumber || header.size == 0)
+        {
+            remove(key);
+            return false;
+        }
+        std::vector<char> binary(header.size);
+        if (!file.read(binary.data(), binary.size()))
+        {
+            remove(key);
+            return false;
+        }
+        file.close();
+
+        glProgramBinary(programId, static_cast<GLenum>(header.format), binary.data(), static_cast<GLsizei>(binary.size()));
+        GLint success = 0;
+        glGetProgramiv(programId, GL_LINK_STATUS, &success);
+        if (!success)
+            remove(key);
+        return success != 0;
+    }
+
+    //Returns false if the program cannot be stored. It's not an error, we just compile it next time.
+    bool store(GLuint programId, const std::string& key)
+    {
+        GLint size = 0;
+        glGetProgramiv(programId, GL_PROGRAM_BINARY_LENGTH, &size);
+        if (size <= 0 || !createDirectory())
+            return false;
+
+        std::vector<char> binary(size);
+        GLenum format;
+        GLsizei length = 0;
+        glGetProgramBinary(programId, size, &length, &format, binary.data());
+        if (length <= 0)
+            return false;
+
+        Header header;
+        header.magic = magicNumber;
+        header.format = static_cast<std::uint32_t>(format);
+        header.size = static_cast<std::uint32_t>(length);
+
+        //Write to a temporary file first, so another process never reads a half-written binary
+        auto path = getPath(key);
+        auto tempPath = path + ".tmp";
+        {
+            std::ofstream file(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+            if (!file.write(reinterpret_cast<const char*>(&header), sizeof(header)) ||
+                !file.write(binary.data(), length))
+            {
+                file.close();
+                std::remove(tempPath.c_str());
+                return false;
+            }
+        }
+#ifdef _WIN32
+        std::remove(path.c_str());
+#endif
+        if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+        {
+            std::remove(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    void remove(const std::string& key)
+    {
+        std::remove(getPath(key).c_str());
+    }
+
+private:
+    struct Header
+    {
+        std::uint32_t magic;
+        std::uint32_t format;
+        std::uint32_t size;
+    };
+
+    static const std::uint32_t magicNumber = 0x42505331; //"1SPB"
+
+    static std::string getString(GLenum name)
+    {
+        auto str = reinterpret_cast<const char*>(glGetString(name));
+        return str != NULL ? str : "";
+    }
+
+    std::string getPath(const std::string& key)
+    {
+        return directory + "/" + key + ".bin";
+    }
+
+    bool createDirectory()
+    {
+#ifdef _WIN32
+        return _mkdir(directory.c_str()) == 0 || errno == EEXIST;
+#else
+        return mkdir(directory.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+    }
+
+private:
+    std::string directory;
+};
+
+#endif
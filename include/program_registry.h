@@ -0,0 +1,151 @@
+#ifndef PROGRAM_REGISTRY_H
+#define PROGRAM_REGISTRY_H
+
+#include <shader_loader.h>
+#include <hash.h>
+
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+//Shared handle to a linked program. The program is deleted when the last handle is destroyed,
+//so keep at least one handle while you render with it.
+typedef std::shared_ptr<ShaderLoader> ProgramHandle;
+
+//Shares programs built from identical shader code. The key is the hash of the code, not the
+//path, so the same shader.vs/shader.fs copied into several chapters is compiled once per
+//context. The hash only picks the candidates: a program is shared only if its code and context
+//are the same, so a collision builds another program. The registry only keeps weak references,
+//it doesn't keep a program alive.
+//
+//    auto& registry = ProgramRegistry::instance();
+//    ProgramHandle shader = registry.get("shaders/shader.vs", "shaders/shader.fs");
+//    shader->use();
+//
+//The programs are built from a copy of the code, so they cannot be hot reloaded. get() throws
+//a string if the program cannot be built, like ShaderLoader::linkShaders().
+class ProgramRegistry
+{
+public:
+    ProgramRegistry() = default;
+    ProgramRegistry(const ProgramRegistry&) = delete;
+    ProgramRegistry& operator=(const ProgramRegistry&) = delete;
+
+    //One registry for the whole process. Programs of different contexts don't collide, since the
+    //current context is part of the key.
+    static ProgramRegistry& instance()
+    {
+        static ProgramRegistry registry;
+        return registry;
+    }
+
+    //Reads the files (or their embedded copy) and returns the program built from their code.
+    //Requires a current context.
+    ProgramHandle get(const char* vertexPath, const char* fragmentPath)
+    {
+        MappedFile vertexFile, fragmentFile;
+        auto vertexCode = loadShaderSource(vertexPath, vertexFile);
+        auto fragmentCode = loadShaderSource(fragmentPath, fragmentFile);
+        return get(vertexCode, fragmentCode);
+    }
+
+    //The program keeps a copy of the code, so the views only need to be valid during the call.
+    //Requires a current context.
+    ProgramHandle get(ShaderSource vertexCode, ShaderSource fragmentCode)
+    {
+        auto key = makeKey(vertexCode, fragmentCode);
+        auto context = glfwGetCurrentContext();
+        auto range = programs.equal_range(key);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second.context != context)
+                continue;
+            auto program = it->second.program.lock();
+            if (program && isSameCode(program->getVertexSource(), vertexCode) &&
+                isSameCode(program->getFragmentSource(), fragmentCode))
+            {
+                ++stats.shared;
+                return program;
+            }
+        }
+        removeExpired();
+
+        ProgramHandle program(new ShaderLoader(std::string(vertexCode.data, vertexCode.size),
+            std::string(fragmentCode.data, fragmentCode.size)));
+        program->setBinaryCacheEnabled(binaryCacheEnabled);
+        program->linkShaders();
+        Entry entry = {context, program};
+        programs.insert(std::make_pair(key, entry));
+        ++stats.linked;
+        return program;
+    }
+
+    //Like ShaderLoader::setBinaryCacheEnabled(), for the programs built from now on
+    void setBinaryCacheEnabled(bool enabled)
+    {
+        binaryCacheEnabled = enabled;
+    }
+
+    //Number of programs which still have a handle
+    std::size_t getProgramCount()
+    {
+        removeExpired();
+        return programs.size();
+    }
+
+    struct Stats
+    {
+        unsigned linked;
+        unsigned shared;
+    };
+
+    //linked counts the programs built by the registry, shared the requests served by an
+    //existing program
+    Stats getStats() const
+    {
+        return stats;
+    }
+
+private:
+    static std::uint64_t makeKey(ShaderSource vertexCode, ShaderSource fragmentCode)
+    {
+        auto hash = fnv1a(vertexCode.data, vertexCode.size);
+        hash = fnv1a(&vertexCode.size, sizeof(vertexCode.size), hash);
+        hash = fnv1a(fragmentCode.data, fragmentCode.size, hash);
+        return fnv1a(&fragmentCode.size, sizeof(fragmentCode.size), hash);
+    }
+
+    static bool isSameCode(ShaderSource a, ShaderSource b)
+    {
+        return a.size == b.size && (a.size == 0 || std::memcmp(a.data, b.data, a.size) == 0);
+    }
+
+    //Entries of deleted programs are only removed here, so we don't need a custom deleter which
+    //would have to outlive the registry
+    void removeExpired()
+    {
+        for (auto it = programs.begin(); it != programs.end(); )
+        {
+            if (it->second.program.expired())
+                it = programs.erase(it);
+            else
+                ++it;
+        }
+    }
+
+private:
+    //GL objects belong to a context, so the same code in another context is another program
+    struct Entry
+    {
+        GLFWwindow* context;
+        std::weak_ptr<ShaderLoader> program;
+    };
+
+    std::unordered_multimap<std::uint64_t, Entry> programs;
+    Stats stats = {0, 0};
+    bool binaryCacheEnabled = true;
+};
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <job_system.h>
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+//A 64-bit key and the index of what it sorts, e.g. a DrawPacket
+struct RadixSortItem
+{
+    std::uint64_t key;
+    std::uint32_t index;
+};
+
+//Items are counted and scattered in blocks of this size, one job per block
+const std::size_t radixSortBlockSize = 16384;
+
+template <typename Function>
+void forEachRadixSortBlock(JobSystem* jobs, std::size_t blockNumber, const Function& function)
+{
+    if (jobs == NULL || blockNumber == 1)
+    {
+        for (std::size_t block = 0; block < blockNumber; ++block)
+            function(block);
+        return;
+    }
+    jobs->parallelFor(0, blockNumber, 1, [&function](std::size_t begin, std::size_t end)
+    {
+        for (auto block = begin; block < end; ++block)
+            function(block);
+    });
+}
+
+//Sorts items by key with a least significant digit radix sort, 8 bits per pass. The sort is
+//stable, so items with equal keys keep their order. Passes over a byte which is the same in all
+//the keys are skipped, so keys which only use a few bits are sorted in a few passes. With jobs, the
+//blocks of each pass are counted and scattered in parallel; it must be called by one of its
+//workers. scratch must have room for itemNumber items.
+inline void radixSort(RadixSortItem* items, RadixSortItem* scratch, std::size_t itemNumber, JobSystem* jobs = NULL)
+{
+    if (itemNumber < 2)
+        return;
+    auto blockNumber = (itemNumber + radixSortBlockSize - 1) / radixSortBlockSize;
+    auto getBlockEnd = [itemNumber](std::size_t block)
+    {
+        return std::min(itemNumber, (block + 1) * radixSortBlockSize);
+    };
+
+    //The bits which differ between the keys
+    std::vector<std::uint64_t> blockDifferences(blockNumber);
+    auto firstKey = items[0].key;
+    forEachRadixSortBlock(jobs, blockNumber, [&](std::size_t block)
+    {
+        std::uint64_t difference = 0;
+        for (auto i = block * radixSortBlockSize; i < getBlockEnd(block); ++i)
+            difference |= items[i].key ^ firstKey;
+        blockDifferences[block] = difference;
+    });
+    std::uint64_t difference = 0;
+    for (auto blockDifference : blockDifferences)
+        difference |= blockDifference;
+
+    //counts[block * 256 + digit] becomes where the block writes its first item with that digit
+    std::vector<std::uint32_t> counts(blockNumber * 256);
+    auto source = items, destination = scratch;
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        if (((difference >> shift) & 0xFF) == 0)
+            continue;
+        forEachRadixSortBlock(jobs, blockNumber, [&](std::size_t block)
+        {
+            auto blockCounts = &counts[block * 256];
+            std::fill(blockCounts, blockCounts + 256, 0);
+            for (auto i = block * radixSortBlockSize; i < getBlockEnd(block); ++i)
+                ++blockCounts[(source[i].key >> shift) & 0xFF];
+        });
+        std::uint32_t offset = 0;
+        for (int digit = 0; digit < 256; ++digit)
+        {
+            for (std::size_t block = 0; block < blockNumber; ++block)
+            {
+                auto count = counts[block * 256 + digit];
+                counts[block * 256 + digit] = offset;
+                offset += count;
+            }
+        }
+        forEachRadixSortBlock(jobs, blockNumber, [&](std::size_t block)
+        {
+            auto offsets = &counts[block * 256];
+            for (auto i = block * radixSortBlockSize; i < getBlockEnd(block); ++i)
+                destination[offsets[(source[i].key >> shift) & 0xFF]++] = source[i];
+        });
+        std::swap(source, destination);
+    }
+    if (source != items)
+    {
+        forEachRadixSortBlock(jobs, blockNumber, [&](std::size_t block)
+        {
+            std::copy(source + block * radixSortBlockSize, source + getBlockEnd(block), items + block * radixSortBlockSize);
+        });
+    }
+}
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef RANGE_ALLOCATOR_H
+#define RANGE_ALLOCATOR_H
+
+#include <map>
+#include <set>
+#include <utility>
+#include <cstddef>
+
+//Hands out ranges of [0, capacity) with a best-fit free list. It only does the bookkeeping, so
+//the units can be anything (bytes, vertices, indices). Free ranges are kept both by offset, to
+//merge a freed range with its neighbours, and by (size, offset), to find the smallest range that
+//fits and to remove a merged range in O(log n). Among ranges of the same size the lowest offset is
+//used first.
+class RangeAllocator
+{
+public:
+    static const std::size_t invalidOffset = static_cast<std::size_t>(-1);
+
+    struct Stats
+    {
+        std::size_t capacity;
+        std::size_t used;
+        std::size_t largestFreeRange;
+        std::size_t freeRangeNumber;
+    };
+
+    explicit RangeAllocator(std::size_t capacity) :
+        capacity{capacity}, used{0}
+    {
+        if (capacity > 0)
+            insertFreeRange(0, capacity);
+    }
+
+    //Returns invalidOffset if there is no free range of this size
+    std::size_t allocate(std::size_t size)
+    {
+        if (size == 0)
+            return invalidOffset;
+        auto bySizeIt = freeBySize.lower_bound(std::make_pair(size, static_cast<std::size_t>(0)));
+        if (bySizeIt == freeBySize.end())
+            return invalidOffset;
+        auto rangeSize = bySizeIt->first;
+        auto offset = bySizeIt->second;
+        freeBySize.erase(bySizeIt);
+        freeByOffset.erase(offset);
+        if (rangeSize > size)
+            insertFreeRange(offset + size, rangeSize - size);
+        used += size;
+        return offset;
+    }
+
+    //size must be the one passed to allocate()
+    void free(std::size_t offset, std::size_t size)
+    {
+        if (offset == invalidOffset || size == 0)
+            return;
+        used -= size;
+        auto next = freeByOffset.lower_bound(offset);
+        //Merge with the following range
+        if (next != freeByOffset.end() && offset + size == next->first)
+        {
+            size += next->second;
+            freeBySize.erase(std::make_pair(next->second, next->first));
+            next = freeByOffset.erase(next);
+        }
+        //Merge with the preceding range
+        if (next != freeByOffset.begin())
+        {
+            auto previous = next;
+            --previous;
+            if (previous->first + previous->second == offset)
+            {
+                offset = previous->first;
+                size += previous->second;
+                freeBySize.erase(std::make_pair(previous->second, previous->first));
+                freeByOffset.erase(previous);
+            }
+        }
+        insertFreeRange(offset, size);
+    }
+
+    Stats getStats() const
+    {
+        Stats stats;
+        stats.capacity = capacity;
+        stats.used = used;
+        stats.largestFreeRange = freeBySize.empty() ? 0 : freeBySize.rbegin()->first;
+        stats.freeRangeNumber = freeByOffset.size();
+        return stats;
+    }
+
+    //0 if all the free space is one range, close to 1 if it's scattered in small ranges, so a
+    //large allocation can fail although there is enough free space in total
+    double getFragmentation() const
+    {
+        auto freeSpace = capacity - used;
+        if (freeSpace == 0)
+            return 0.0;
+        return 1.0 - static_cast<double>(getStats().largestFreeRange) / freeSpace;
+    }
+
+private:
+    void insertFreeRange(std::size_t offset, std::size_t size)
+    {
+        freeByOffset[offset] = size;
+        freeBySize.insert(std::make_pair(size, offset));
+    }
+
+private:
+    std::size_t capacity;
+    std::size_t used;
+    std::map<std::size_t, std::size_t> freeByOffset;
+    std::set<std::pair<std::size_t, std::size_t>> freeBySize;
+};
+
+#endif
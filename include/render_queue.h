@@ -0,0 +1,424 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <opengl_loader.h>
+#include <shader_loader.h>
+#include <gl_state_cache.h>
+#include <mesh_arena.h>
+#include <instance_buffer.h>
+#include <ring_buffer.h>
+#include <radix_sort.h>
+#include <job_system.h>
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+
+//One draw, recorded without calling OpenGL. It only holds numbers, so any thread can fill it and
+//it's copied and sorted as it is. The mesh is drawn with glDrawElementsBaseVertex from GLuint
+//indices, like MeshArena::draw().
+struct DrawPacket
+{
+    //Packets are executed in increasing key order, equal keys in recording order. See
+    //makeDrawSortKey().
+    std::uint64_t key;
+    GLuint program;
+    GLuint vertexArray;
+    //Returned by RenderQueue::addTextureSet(), or RenderQueue::noTextureSet
+    std::uint32_t textureSet;
+    //The Draw uniform block of the draw, from RenderCommandBuffer::allocateUniforms(). Size 0 if
+    //the program doesn't have one.
+    std::uint32_t uniformOffset;
+    std::uint32_t uniformSize;
+    //Instances of the InstanceBuffer attached to the VAO, instanceCount 0 for a draw which isn't
+    //instanced
+    std::uint32_t firstInstance;
+    std::uint32_t instanceCount;
+    MeshRange mesh;
+};
+
+//Bits of the DrawPacket keys made by makeDrawSortKey(), from the most significant one
+const int drawKeyLayerBits = 4;
+const int drawKeyProgramBits = 12;
+const int drawKeyTextureSetBits = 12;
+const int drawKeyVertexArrayBits = 12;
+const int drawKeyDepthBits = 24;
+
+//A key which sorts the draws by layer (e.g. opaque before transparent), then by program, texture
+//set and VAO, so the draws which share them are next to each other and the state changes as
+//rarely as possible, then front to back inside the same state, so early depth testing rejects
+//the hidden fragments. depth is the view depth divided by the far plane. Only the low bits of the
+//ids are kept, which are unique as long as the drivers name the objects from 1 on; if two ids
+//share them, their draws may just be interleaved.
+inline std::uint64_t makeDrawSortKey(unsigned layer, GLuint program, std::uint32_t textureSet, GLuint vertexArray, float depth)
+{
+    const auto depthMax = (1u << drawKeyDepthBits) - 1;
+    depth = std::min(std::max(depth, 0.0f), 1.0f);
+    std::uint64_t key = layer & ((1u << drawKeyLayerBits) - 1);
+    key = key << drawKeyProgramBits | (program & ((1u << drawKeyProgramBits) - 1));
+    key = key << drawKeyTextureSetBits | (textureSet & ((1u << drawKeyTextureSetBits) - 1));
+    key = key << drawKeyVertexArrayBits | (vertexArray & ((1u << drawKeyVertexArrayBits) - 1));
+    return key << drawKeyDepthBits | static_cast<std::uint32_t>(depth * depthMax);
+}
+
+//Binds between adjacent packets, the first packet binds everything
+struct DrawStateChanges
+{
+    unsigned programs;
+    unsigned textureSets;
+    unsigned vertexArrays;
+};
+
+inline DrawStateChanges countDrawStateChanges(const DrawPacket* packets, std::size_t packetNumber)
+{
+    DrawStateChanges changes = {0, 0, 0};
+    for (std::size_t i = 0; i < packetNumber; ++i)
+    {
+        const auto& packet = packets[i];
+        if (i == 0 || packet.program != packets[i - 1].program)
+            ++changes.programs;
+        if (i == 0 || packet.textureSet != packets[i - 1].textureSet)
+            ++changes.textureSets;
+        if (i == 0 || packet.vertexArray != packets[i - 1].vertexArray)
+            ++changes.vertexArrays;
+    }
+    return changes;
+}
+
+//Where a thread records its packets and their uniforms. The memory is kept from frame to frame,
+//so recording doesn't allocate once the buffers have grown to the size of a frame.
+class RenderCommandBuffer
+{
+public:
+    explicit RenderCommandBuffer(std::size_t uniformAlignment) :
+        uniformAlignment{uniformAlignment}
+    {
+    }
+
+    RenderCommandBuffer(const RenderCommandBuffer&) = delete;
+    RenderCommandBuffer& operator=(const RenderCommandBuffer&) = delete;
+
+    void draw(const DrawPacket& packet)
+    {
+        packets.push_back(packet);
+    }
+
+    //Reserves an aligned block for the Draw uniform block of a packet and returns where to write
+    //it. The pointer is valid until the next allocation, the offset until the queue is reset.
+    void* allocateUniforms(std::size_t size, std::uint32_t& offset)
+    {
+        auto start = (uniforms.size() + uniformAlignment - 1) / uniformAlignment * uniformAlignment;
+        uniforms.resize(start + size);
+        offset = static_cast<std::uint32_t>(start);
+        return uniforms.data() + start;
+    }
+
+    void clear()
+    {
+        packets.clear();
+        uniforms.clear();
+    }
+
+    const std::vector<DrawPacket>& getPackets() const
+    {
+        return packets;
+    }
+
+    const std::vector<unsigned char>& getUniforms() const
+    {
+        return uniforms;
+    }
+
+private:
+    std::size_t uniformAlignment;
+    std::vector<DrawPacket> packets;
+    std::vector<unsigned char> uniforms;
+};
+
+//Splits the draws of a frame between the threads which decide what to draw and the thread which
+//owns the context. Jobs walk the scene and record DrawPackets, each into the command buffer of
+//its worker, so the recording needs no lock and scales with the cores. The OpenGL thread then
+//gathers the buffers, sorts the packets by key and submits them through a GLStateCache, so it
+//does nothing but issue the calls that change something.
+//
+//    RenderQueue queue(jobs.getThreadNumber());
+//    auto crate = queue.addTextureSet(&crateTexture, 1);
+//    ...
+//    queue.reset();
+//    jobs.parallelFor(0, objectNumber, 256, [&](std::size_t begin, std::size_t end)
+//    {
+//        auto& commands = queue.getCommandBuffer(jobs.getWorkerIndex());
+//        for (auto i = begin; i < end; ++i)
+//            commands.draw(makePacket(objects[i], commands));
+//    });
+//    ring.beginFrame();
+//    queue.sort(&ring, &jobs);
+//    ring.flush();
+//    queue.execute(glState, ring.getBufferId(), &instances);
+//    ring.endFrame();
+//
+//The Draw uniform blocks of the packets are copied to the RingBuffer, which must be created with
+//GL_UNIFORM_BUFFER as target, and bound to drawBlockBinding before each draw that has one.
+//Instance ranges use glDrawElementsInstancedBaseVertexBaseInstance on GL 4.2 or with
+//GL_ARB_base_instance. Otherwise the instance attribute of the VAO is moved to the first
+//instance of each draw, which requires the InstanceBuffer, and moved back after the frame.
+class RenderQueue
+{
+public:
+    struct Stats
+    {
+        //Of the last frame
+        unsigned packets;
+        std::size_t uniformBytes;
+        //In the order the packets were recorded, and sorted by key
+        DrawStateChanges recordedChanges;
+        DrawStateChanges sortedChanges;
+        //Time spent in sort() and execute() in the last frame, i.e. on the OpenGL thread
+        double sortMilliseconds;
+        double executeMilliseconds;
+    };
+
+    static const std::uint32_t noTextureSet = 0xFFFFFFFF;
+    static const unsigned maxTextureSetSize = 4;
+
+    //Requires a current context. threadNumber is the number of command buffers, one per thread
+    //which records.
+    explicit RenderQueue(unsigned threadNumber) :
+        baseInstance{isBaseInstanceSupported()}, uniformAlignment{RingBuffer::getUniformAlignment()}, stats()
+    {
+        for (unsigned i = 0; i < std::max(1u, threadNumber); ++i)
+            commandBuffers.push_back(std::unique_ptr<RenderCommandBuffer>(new RenderCommandBuffer(uniformAlignment)));
+    }
+
+    RenderQueue(const RenderQueue&) = delete;
+    RenderQueue& operator=(const RenderQueue&) = delete;
+
+    //Textures bound to units 0 to textureNumber - 1 as GL_TEXTURE_2D. Returns the index to put in
+    //DrawPacket::textureSet. Not while packets are recorded.
+    std::uint32_t addTextureSet(const GLuint* textures, unsigned textureNumber)
+    {
+        if (textureNumber > maxTextureSetSize)
+            throw std::string("RenderQueue: a texture set has at most ") + std::to_string(maxTextureSetSize) + " textures";
+        TextureSet set = {{0, 0, 0, 0}, textureNumber};
+        std::copy(textures, textures + textureNumber, set.textures);
+        textureSets.push_back(set);
+        return static_cast<std::uint32_t>(textureSets.size() - 1);
+    }
+
+    //Each recording thread uses its own, e.g. the one of JobSystem::getWorkerIndex()
+    RenderCommandBuffer& getCommandBuffer(unsigned thread)
+    {
+        return *commandBuffers[thread];
+    }
+
+    unsigned getCommandBufferNumber() const
+    {
+        return static_cast<unsigned>(commandBuffers.size());
+    }
+
+    //Forgets the packets of the last frame, before the recording starts
+    void reset()
+    {
+        for (auto& commandBuffer : commandBuffers)
+            commandBuffer->clear();
+    }
+
+    //Gathers the packets of all the command buffers and sorts them by key, once the recording is
+    //over. The uniforms are copied to uniforms, which must be between beginFrame() and flush(). It
+    //can be NULL if no packet has uniforms. With jobs, which must be called from one of its
+    //workers, the keys are sorted in parallel.
+    void sort(RingBuffer* uniforms, JobSystem* jobs = NULL)
+    {
+        auto start = std::chrono::steady_clock::now();
+        recordedPackets.clear();
+        stats.uniformBytes = 0;
+        for (const auto& commandBuffer : commandBuffers)
+        {
+            const auto& bufferUniforms = commandBuffer->getUniforms();
+            std::uint32_t base = 0;
+            if (!bufferUniforms.empty())
+            {
+                if (uniforms == NULL)
+                    throw std::string("RenderQueue: packets with uniforms need a RingBuffer");
+                auto allocation = uniforms->allocate(bufferUniforms.size(), uniformAlignment);
+                if (allocation.data == NULL)
+                    throw std::string("RenderQueue: the uniforms of the frame don't fit in the RingBuffer");
+                std::memcpy(allocation.data, bufferUniforms.data(), bufferUniforms.size());
+                base = static_cast<std::uint32_t>(allocation.offset);
+                stats.uniformBytes += bufferUniforms.size();
+            }
+            for (auto packet : commandBuffer->getPackets())
+            {
+                packet.uniformOffset += base;
+                recordedPackets.push_back(packet);
+            }
+        }
+
+        //The keys are sorted with the packet indices, which is less to move than the packets
+        auto packetNumber = recordedPackets.size();
+        sortItems.resize(packetNumber);
+        sortScratch.resize(packetNumber);
+        for (std::size_t i = 0; i < packetNumber; ++i)
+        {
+            sortItems[i].key = recordedPackets[i].key;
+            sortItems[i].index = static_cast<std::uint32_t>(i);
+        }
+        radixSort(sortItems.data(), sortScratch.data(), packetNumber, jobs);
+        packets.resize(packetNumber);
+        for (std::size_t i = 0; i < packetNumber; ++i)
+            packets[i] = recordedPackets[sortItems[i].index];
+
+        stats.packets = static_cast<unsigned>(packetNumber);
+        stats.recordedChanges = countDrawStateChanges(recordedPackets.data(), packetNumber);
+        stats.sortedChanges = countDrawStateChanges(packets.data(), packetNumber);
+        stats.sortMilliseconds = getMilliseconds(start);
+    }
+
+    //Issues the sorted packets. uniformBuffer is the RingBuffer given to sort(). instances is only
+    //needed without base instances, for the packets which don't start at instance 0.
+    void execute(GLStateCache& state, GLuint uniformBuffer, const InstanceBuffer* instances = NULL,
+        GLuint instanceLocation = InstanceBuffer::defaultLocation)
+    {
+        auto start = std::chrono::steady_clock::now();
+        GLuint movedVertexArray = 0;
+        std::uint32_t movedFirstInstance = 0;
+        movedVertexArrays.clear();
+        for (const auto& packet : packets)
+        {
+            state.useProgram(packet.program);
+            state.bindVertexArray(packet.vertexArray);
+            if (packet.textureSet != noTextureSet)
+            {
+                const auto& set = textureSets[packet.textureSet];
+                for (unsigned unit = 0; unit < set.textureNumber; ++unit)
+                    state.bindTexture(unit, GL_TEXTURE_2D, set.textures[unit]);
+            }
+            if (packet.uniformSize > 0)
+                state.bindBufferRange(GL_UNIFORM_BUFFER, drawBlockBinding, uniformBuffer, packet.uniformOffset, packet.uniformSize);
+
+            auto indices = reinterpret_cast<void*>(packet.mesh.firstIndex * sizeof(GLuint));
+            if (packet.instanceCount == 0)
+            {
+                glDrawElementsBaseVertex(GL_TRIANGLES, packet.mesh.indexCount, GL_UNSIGNED_INT, indices, packet.mesh.baseVertex);
+                continue;
+            }
+            auto instanceCount = static_cast<GLsizei>(packet.instanceCount);
+            if (baseInstance)
+            {
+                glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, packet.mesh.indexCount, GL_UNSIGNED_INT, indices,
+                    instanceCount, packet.mesh.baseVertex, packet.firstInstance);
+                continue;
+            }
+            //The attribute stays where it was moved last in each VAO
+            if (packet.vertexArray != movedVertexArray)
+            {
+                movedVertexArray = packet.vertexArray;
+                movedFirstInstance = 0;
+                for (const auto& moved : movedVertexArrays)
+                {
+                    if (moved.vertexArray == movedVertexArray)
+                        movedFirstInstance = moved.firstInstance;
+                }
+            }
+            if (packet.firstInstance != movedFirstInstance)
+            {
+                if (instances == NULL)
+                    throw std::string("RenderQueue: instance ranges need the InstanceBuffer without GL_ARB_base_instance");
+                state.bindBuffer(GL_ARRAY_BUFFER, instances->getBufferId());
+                instances->setFirstInstance(packet.firstInstance, instanceLocation);
+                movedFirstInstance = packet.firstInstance;
+                setMovedFirstInstance(movedVertexArray, movedFirstInstance);
+            }
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, packet.mesh.indexCount, GL_UNSIGNED_INT, indices, instanceCount,
+                packet.mesh.baseVertex);
+        }
+        for (const auto& moved : movedVertexArrays)
+        {
+            if (moved.firstInstance == 0)
+                continue;
+            state.bindVertexArray(moved.vertexArray);
+            state.bindBuffer(GL_ARRAY_BUFFER, instances->getBufferId());
+            instances->setFirstInstance(0, instanceLocation);
+        }
+        stats.executeMilliseconds = getMilliseconds(start);
+    }
+
+    //The sorted packets of the frame, after sort()
+    const std::vector<DrawPacket>& getPackets() const
+    {
+        return packets;
+    }
+
+    bool isBaseInstanceUsed() const
+    {
+        return baseInstance;
+    }
+
+    Stats getStats() const
+    {
+        return stats;
+    }
+
+    static bool isBaseInstanceSupported()
+    {
+        if (!isOpenGLVersionAtLeast(4, 2) && !isOpenGLExtensionSupported("GL_ARB_base_instance"))
+            return false;
+#ifdef USE_GLAD
+        if (glDrawElementsInstancedBaseVertexBaseInstance == NULL)
+            return false;
+#endif
+        return true;
+    }
+
+private:
+    struct TextureSet
+    {
+        GLuint textures[maxTextureSetSize];
+        unsigned textureNumber;
+    };
+
+    struct MovedVertexArray
+    {
+        GLuint vertexArray;
+        std::uint32_t firstInstance;
+    };
+
+    void setMovedFirstInstance(GLuint vertexArray, std::uint32_t firstInstance)
+    {
+        for (auto& moved : movedVertexArrays)
+        {
+            if (moved.vertexArray == vertexArray)
+            {
+                moved.firstInstance = firstInstance;
+                return;
+            }
+        }
+        MovedVertexArray moved = {vertexArray, firstInstance};
+        movedVertexArrays.push_back(moved);
+    }
+
+    static double getMilliseconds(std::chrono::steady_clock::time_point start)
+    {
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    }
+
+private:
+    bool baseInstance;
+    std::size_t uniformAlignment;
+    std::vector<std::unique_ptr<RenderCommandBuffer>> commandBuffers;
+    std::vector<TextureSet> textureSets;
+    std::vector<DrawPacket> recordedPackets;
+    std::vector<DrawPacket> packets;
+    std::vector<RadixSortItem> sortItems;
+    std::vector<RadixSortItem> sortScratch;
+    std::vector<MovedVertexArray> movedVertexArrays;
+    Stats stats;
+};
+
+#endif
@@ -0,0 +1,271 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <opengl_loader.h>
+#include <gl_state_cache.h>
+
+#include <cstddef>
+#include <cstdint>
+
+//Streams data which changes every frame (transforms, per-draw constants) without making the
+//driver wait for the GPU or allocate a new buffer. The buffer has a region for each of the
+//frames in flight. We write the data of a frame into its region and put a fence after the
+//draws which read it, so the region is reused only after the GPU has finished with it.
+//
+//With GL 4.4 or GL_ARB_buffer_storage, the buffer is created by glBufferStorage and mapped once
+//with GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT, so writes are visible to the GPU without any
+//call. On a 3.3 context, or if the persistent mapping fails, it falls back to one region which
+//is orphaned by glBufferData and mapped at the start of each frame; the driver gives us fresh
+//memory while the GPU reads the old one. Either way a frame goes like this:
+//
+//    ring.beginFrame();
+//    auto transforms = ring.allocate(drawNumber * sizeof(glm::mat4), 16);
+//    auto constants = ring.allocate(sizeof(DrawConstants), RingBuffer::getUniformAlignment());
+//    //fill transforms.data and constants.data
+//    ring.flush();
+//    glBindBufferRange(GL_UNIFORM_BUFFER, 1, ring.getBufferId(), constants.offset, constants.size);
+//    //draw
+//    ring.endFrame();
+//
+//Allocations must not be written after flush(), since the fallback unmaps the buffer there.
+class RingBuffer
+{
+public:
+    struct Allocation
+    {
+        //NULL if the frame is full
+        void* data;
+        //Offset in the buffer, for glBindBufferRange or glVertexAttribPointer
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+
+    struct Stats
+    {
+        //Frames which had to wait for the GPU to release their region
+        unsigned stalls;
+        //Allocations which didn't fit in the frame, or were made while the buffer wasn't mapped
+        unsigned failedAllocations;
+        //Frames whose region couldn't be mapped
+        unsigned failedMappings;
+    };
+
+    static const int maxFramesInFlight = 3;
+
+    //Requires a current context. frameSize is the capacity of one frame in bytes. The target is
+    //the one the buffer is bound to while creating, mapping and orphaning it.
+    explicit RingBuffer(std::size_t frameSize, GLenum target = GL_ARRAY_BUFFER) :
+        target{target}, frameSize{frameSize}, persistent{isPersistentMappingSupported()}, frame{0},
+        frameOffset{0}, used{0}, mapped{NULL}, stats{0, 0, 0}
+    {
+        for (auto& fence : fences)
+            fence = NULL;
+        glGenBuffers(1, &bufferId);
+        glBindBuffer(target, bufferId);
+        if (persistent)
+        {
+            GLsizeiptr size = static_cast<GLsizeiptr>(frameSize * maxFramesInFlight);
+            glBufferStorage(target, size, NULL, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+            persistentData = static_cast<char*>(glMapBufferRange(target, 0, size,
+                GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT));
+            //The storage of glBufferStorage can't be respecified, so the fallback needs a new buffer
+            if (persistentData == NULL)
+            {
+                persistent = false;
+                glBindBuffer(target, 0);
+                glDeleteBuffers(1, &bufferId);
+                glGenBuffers(1, &bufferId);
+                glBindBuffer(target, bufferId);
+            }
+        }
+        if (!persistent)
+        {
+            glBufferData(target, static_cast<GLsizeiptr>(frameSize), NULL, GL_STREAM_DRAW);
+            persistentData = NULL;
+        }
+        glBindBuffer(target, 0);
+    }
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    ~RingBuffer()
+    {
+        if (glfwGetCurrentContext() == NULL)
+            return;
+        for (auto& fence : fences)
+        {
+            if (fence != NULL)
+                glDeleteSync(fence);
+        }
+        //The persistent mapping is released with the buffer
+        glDeleteBuffers(1, &bufferId);
+    }
+
+    //Requires a current context
+    static bool isPersistentMappingSupported()
+    {
+        if (!isOpenGLVersionAtLeast(4, 4) && !isOpenGLExtensionSupported("GL_ARB_buffer_storage"))
+            return false;
+#ifdef USE_GLAD
+        if (glBufferStorage == NULL)
+            return false;
+#endif
+        return true;
+    }
+
+    //The alignment of offsets passed to glBindBufferRange(GL_UNIFORM_BUFFER, ...)
+    static std::size_t getUniformAlignment()
+    {
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        return alignment > 0 ? static_cast<std::size_t>(alignment) : 256;
+    }
+
+    //Waits until the GPU is done with the region of this frame, which is only the case when we
+    //are more than maxFramesInFlight frames ahead. The fallback binds the buffer to map it:
+    //through state if you pass one, where it stays bound, otherwise directly and unbound
+    //afterwards. The same goes for flush() and endFrame().
+    void beginFrame(GLStateCache* state = NULL)
+    {
+        used = 0;
+        if (persistent)
+        {
+            frameOffset = frame * frameSize;
+            waitFence(fences[frame]);
+            mapped = persistentData + frameOffset;
+            return;
+        }
+        frameOffset = 0;
+        bind(state);
+        //Orphan the storage, the GPU keeps reading the old one
+        glBufferData(target, static_cast<GLsizeiptr>(frameSize), NULL, GL_STREAM_DRAW);
+        mapped = static_cast<char*>(glMapBufferRange(target, 0, static_cast<GLsizeiptr>(frameSize),
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+        unbind(state);
+        //allocate() fails for the whole frame if the mapping did
+        if (mapped == NULL)
+            ++stats.failedMappings;
+    }
+
+    //alignment must be a power of two
+    Allocation allocate(std::size_t size, std::size_t alignment = 16)
+    {
+        auto start = (frameOffset + used + alignment - 1) & ~(alignment - 1);
+        auto end = start + size;
+        if (mapped == NULL || end > frameOffset + frameSize)
+        {
+            ++stats.failedAllocations;
+            Allocation allocation = {NULL, 0, 0};
+            return allocation;
+        }
+        used = end - frameOffset;
+        Allocation allocation =
+        {
+            mapped + (start - frameOffset),
+            static_cast<GLintptr>(start),
+            static_cast<GLsizeiptr>(size)
+        };
+        return allocation;
+    }
+
+    //Makes the data of the frame visible to the GPU. Call it after the last allocate() of the
+    //frame, before the draws which read it.
+    void flush(GLStateCache* state = NULL)
+    {
+        if (persistent || mapped == NULL)
+            return;
+        bind(state);
+        glUnmapBuffer(target);
+        unbind(state);
+        mapped = NULL;
+    }
+
+    //Call it after the last draw which reads the data of this frame
+    void endFrame(GLStateCache* state = NULL)
+    {
+        flush(state);
+        if (persistent)
+        {
+            fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, {});
+            frame = (frame + 1) % maxFramesInFlight;
+        }
+        mapped = NULL;
+    }
+
+    bool isPersistent() const
+    {
+        return persistent;
+    }
+
+    GLuint getBufferId() const
+    {
+        return bufferId;
+    }
+
+    std::size_t getFrameSize() const
+    {
+        return frameSize;
+    }
+
+    //Bytes allocated in the current frame, including the alignment padding
+    std::size_t getUsedSize() const
+    {
+        return used;
+    }
+
+    Stats getStats() const
+    {
+        return stats;
+    }
+
+private:
+    void waitFence(GLsync& fence)
+    {
+        if (fence == NULL)
+            return;
+        //Don't count it as a stall if the GPU is already done
+        auto result = glClientWaitSync(fence, {}, 0);
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+        {
+            ++stats.stalls;
+            //Flush, otherwise the fence may never reach the GPU
+            do
+            {
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            }
+            while (result == GL_TIMEOUT_EXPIRED);
+        }
+        glDeleteSync(fence);
+        fence = NULL;
+    }
+
+    void bind(GLStateCache* state)
+    {
+        if (state != NULL)
+            state->bindBuffer(target, bufferId);
+        else
+            glBindBuffer(target, bufferId);
+    }
+
+    void unbind(GLStateCache* state)
+    {
+        if (state == NULL)
+            glBindBuffer(target, 0);
+    }
+
+private:
+    GLuint bufferId;
+    GLenum target;
+    std::size_t frameSize;
+    bool persistent;
+    std::size_t frame;
+    std::size_t frameOffset;
+    std::size_t used;
+    char* mapped;
+    char* persistentData;
+    GLsync fences[maxFramesInFlight];
+    Stats stats;
+};
+
+#endif
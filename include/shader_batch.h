@@ -0,0 +1,88 @@
+#ifndef SHADER_BATCH_H
+#define SHADER_BATCH_H
+
+#include <shader_loader.h>
+
+#include <vector>
+#include <cstddef>
+
+//Builds many programs at once. ShaderLoader::linkShaders() asks for the status right after each
+//compile and link, so the driver has to finish one program before we submit the next. A batch
+//submits all of them first and asks for the results later.
+//
+//With GL_KHR_parallel_shader_compile the driver compiles on its own threads and poll() only
+//finishes the programs that are ready, so it never blocks the frame loop. Without the extension
+//there is no way to ask if a program is ready, so poll() leaves them and each program is
+//finished on its first use (ShaderLoader::use() or getProgramId()).
+//
+//    ShaderBatch batch;
+//    batch.add(shader1);
+//    batch.add(shader2);
+//    while (!glfwWindowShouldClose(window))
+//    {
+//        batch.poll();
+//        ...
+//    }
+class ShaderBatch
+{
+public:
+    ShaderBatch()
+    {
+        //Let the driver decide how many threads to use
+        if (isParallelShaderCompileSupported())
+            glextMaxShaderCompilerThreads(0xFFFFFFFF);
+    }
+
+    //Submits the shader. It must outlive the batch or be finished before it's destroyed.
+    void add(ShaderLoader& shader)
+    {
+        shader.beginLink();
+        pending.push_back(&shader);
+    }
+
+    //Finishes the programs which are ready and returns true if nothing is pending. If a program
+    //fails, it's removed from the batch and the error string is thrown, so the rest of the batch
+    //can be polled again.
+    bool poll()
+    {
+        if (!isParallelShaderCompileSupported())
+        {
+            pending.clear();
+            return true;
+        }
+        for (std::size_t i = 0; i < pending.size(); )
+        {
+            if (pending[i]->isLinkComplete())
+                finish(i);
+            else
+                ++i;
+        }
+        return pending.empty();
+    }
+
+    //Blocks until every program is finished
+    void finishAll()
+    {
+        while (!pending.empty())
+            finish(pending.size() - 1);
+    }
+
+    std::size_t getPendingCount() const
+    {
+        return pending.size();
+    }
+
+private:
+    void finish(std::size_t index)
+    {
+        auto shader = pending[index];
+        pending[index] = pending.back();
+        pending.pop_back();
+        shader->finishLink();
+    }
+
+private:
+    std::vector<ShaderLoader*> pending;
+};
+
+#endif
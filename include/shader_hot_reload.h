@@ -0,0 +1,217 @@
+#ifndef SHADER_HOT_RELOAD_H
+#define SHADER_HOT_RELOAD_H
+
+#include <shader_loader.h>
+#include <spsc_queue.h>
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <iostream>
+#include <cstddef>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+//Reloads shaders when their files change, without restarting the program. A background thread
+//watches the directories of the shader files with inotify and pushes the index of each changed
+//file to a lock-free queue. update() runs on the GL thread at a frame boundary and rebuilds only
+//the programs that use a changed file (see ShaderLoader::reload()).
+//
+//We only react to IN_CLOSE_WRITE and IN_MOVED_TO, i.e. after the writer closed the file or an
+//editor renamed its temporary file over it, so we never read a half-written file. If the new
+//code doesn't compile, the old program stays in use.
+//
+//Watching is only implemented on Linux; on other platforms start() returns false. Shaders must
+//be loaded from files, so turn EMBED_SHADERS off or edit the copies next to the executable.
+//
+//    ShaderHotReload hotReload;
+//    hotReload.add(shader);
+//    hotReload.start();
+//    while (!glfwWindowShouldClose(window))
+//    {
+//        hotReload.update();
+//        renderFrame(...);
+//        ...
+//    }
+class ShaderHotReload
+{
+public:
+    ShaderHotReload() :
+        events(256), running{false}, overflowed{false}
+    {
+    }
+
+    ShaderHotReload(const ShaderHotReload&) = delete;
+    ShaderHotReload& operator=(const ShaderHotReload&) = delete;
+
+    ~ShaderHotReload()
+    {
+        stop();
+    }
+
+    //Must be called before start(). The shader must outlive this object.
+    void add(ShaderLoader& shader)
+    {
+        if (shader.getVertexPath() != NULL)
+            addFile(shader.getVertexPath(), shader);
+        if (shader.getFragmentPath() != NULL)
+            addFile(shader.getFragmentPath(), shader);
+    }
+
+    //Returns false if the files cannot be watched
+    bool start()
+    {
+#ifdef __linux__
+        if (running)
+            return true;
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotifyFd < 0)
+            return false;
+        for (auto& file : files)
+        {
+            file.watchDescriptor = inotify_add_watch(inotifyFd, file.directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+            if (file.watchDescriptor < 0)
+                std::cerr << "Cannot watch " << file.directory << std::endl;
+        }
+        running = true;
+        watcher = std::thread(&ShaderHotReload::watch, this);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void stop()
+    {
+#ifdef __linux__
+        if (!running)
+            return;
+        running = false;
+        watcher.join();
+        close(inotifyFd);
+        inotifyFd = -1;
+#endif
+    }
+
+    //Call it on the GL thread between frames. Returns the number of reloaded programs. Pass the
+    //GLStateCache of the frame loop if there is one, since reloading binds programs.
+    int update(GLStateCache* state = NULL)
+    {
+        changedShaders.clear();
+        std::size_t fileIndex;
+        while (events.pop(fileIndex))
+        {
+            const auto& shaders = files[fileIndex].shaders;
+            changedShaders.insert(changedShaders.end(), shaders.begin(), shaders.end());
+        }
+        //We lost some events, so we don't know which files are changed
+        if (overflowed.exchange(false))
+        {
+            for (const auto& file : files)
+                changedShaders.insert(changedShaders.end(), file.shaders.begin(), file.shaders.end());
+        }
+        if (changedShaders.empty())
+            return 0;
+
+        std::sort(changedShaders.begin(), changedShaders.end());
+        changedShaders.erase(std::unique(changedShaders.begin(), changedShaders.end()), changedShaders.end());
+        int reloaded = 0;
+        for (auto shader : changedShaders)
+        {
+            std::string error;
+            if (shader->reload(error, state))
+            {
+                ++reloaded;
+                std::cout << "Reloaded " << shader->getVertexPath() << ", " << shader->getFragmentPath() << std::endl;
+            }
+            else
+                std::cerr << error << std::endl;
+        }
+        return reloaded;
+    }
+
+private:
+    struct WatchedFile
+    {
+        std::string directory;
+        std::string name;
+        int watchDescriptor;
+        std::vector<ShaderLoader*> shaders;
+    };
+
+    void addFile(const std::string& path, ShaderLoader& shader)
+    {
+        auto separator = path.find_last_of("/\\");
+        WatchedFile file;
+        file.directory = separator == std::string::npos ? "." : path.substr(0, separator);
+        file.name = separator == std::string::npos ? path : path.substr(separator + 1);
+        file.watchDescriptor = -1;
+        for (auto& watchedFile : files)
+        {
+            if (watchedFile.directory == file.directory && watchedFile.name == file.name)
+            {
+                watchedFile.shaders.push_back(&shader);
+                return;
+            }
+        }
+        file.shaders.push_back(&shader);
+        files.push_back(file);
+    }
+
+#ifdef __linux__
+    //Runs on the watcher thread. files is not modified after start(), so it can be read here
+    //without a lock.
+    void watch()
+    {
+        alignas(inotify_event) char buffer[4096];
+        while (running)
+        {
+            pollfd pollFd = {inotifyFd, POLLIN, 0};
+            //Wake up regularly to check running
+            if (poll(&pollFd, 1, 100) <= 0)
+                continue;
+            auto length = read(inotifyFd, buffer, sizeof(buffer));
+            if (length <= 0)
+                continue;
+            for (char* ptr = buffer; ptr < buffer + length; )
+            {
+                auto event = reinterpret_cast<const inotify_event*>(ptr);
+                if (event->mask & IN_Q_OVERFLOW)
+                    overflowed = true;
+                else if (event->len > 0)
+                    notify(event->wd, event->name);
+                ptr += sizeof(inotify_event) + event->len;
+            }
+        }
+    }
+
+    void notify(int watchDescriptor, const char* name)
+    {
+        for (std::size_t i = 0; i < files.size(); ++i)
+        {
+            if (files[i].watchDescriptor == watchDescriptor && files[i].name == name)
+            {
+                if (!events.push(i))
+                    overflowed = true;
+            }
+        }
+    }
+#endif
+
+private:
+    std::vector<WatchedFile> files;
+    SpscQueue<std::size_t> events;
+    std::atomic<bool> running, overflowed;
+    std::thread watcher;
+    int inotifyFd = -1;
+    //Only used by update(), it's a member to avoid allocations in each frame
+    std::vector<ShaderLoader*> changedShaders;
+};
+
+#endif
@@ -2,80 +2,646 @@
 #define SHADER_LOADER_H
 
 #include <opengl_loader.h>
+#include <program_binary_cache.h>
+#include <gl_state_cache.h>
+#include <hash.h>
+#include <shader_source.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 #include <string>
-#include <fstream>
-#include <sstream>
+#include <vector>
+#include <cstdint>
+#include <cstring>
 #include <memory>
 #include <iostream>
 #include <exception>
 
+//Name of a uniform variable in the form of its hash. Constructing it from a string literal
+//is constexpr, so the setters don't need to hash or compare strings at run time.
+class UniformName
+{
+public:
+    template <std::size_t N>
+    constexpr UniformName(const char (&name)[N]) :
+        hash{hashString(name)}
+    {
+    }
+
+    explicit UniformName(const std::string& name) :
+        hash{hashString(name.c_str())}
+    {
+    }
+
+    explicit constexpr UniformName(std::uint64_t hash) :
+        hash{hash}
+    {
+    }
+
+    std::uint64_t hash;
+};
+
+//Uniform blocks shared by all programs. If a program declares a block with one of these names,
+//it's bound to the binding point when the program is linked, so a buffer bound there once (see
+//CameraUniformBuffer) is used by every program.
+const GLuint cameraBlockBinding = 0;
+//Per-draw uniforms of a RenderQueue, bound to a range of its buffer before each draw
+const GLuint drawBlockBinding = 1;
+
+struct UniformBlockBinding
+{
+    const char* name;
+    GLuint binding;
+};
+
+const UniformBlockBinding uniformBlockBindings[] =
+{
+    {"Camera", cameraBlockBinding},
+    {"Draw", drawBlockBinding}
+};
+
 class ShaderLoader
 {
 public:
+    //Reads the shaders from the files. If the executable is built with embedded shaders (see
+    //EMBED_SHADERS option in CMake), the embedded copy of the file is used instead.
     explicit ShaderLoader(const char* vertexPath, const char* fragmentPath) :
         vertexPath{vertexPath}, fragmentPath{fragmentPath}
     {
     }
 
-    void linkShaders()
+    //Uses the source code in memory. It's not copied, so it must outlive every beginLink().
+    explicit ShaderLoader(ShaderSource vertexSource, ShaderSource fragmentSource) :
+        vertexPath{NULL}, fragmentPath{NULL}, vertexSource{vertexSource}, fragmentSource{fragmentSource}
+    {
+    }
+
+    //Keeps its own copy of the source code, so the program can be linked again at any time
+    explicit ShaderLoader(std::string vertexCode, std::string fragmentCode) :
+        vertexPath{NULL}, fragmentPath{NULL}, vertexCode{std::move(vertexCode)},
+        fragmentCode{std::move(fragmentCode)}, ownsSources{true}
+    {
+        vertexSource = ShaderSource(this->vertexCode);
+        fragmentSource = ShaderSource(this->fragmentCode);
+    }
+
+    //A ShaderLoader owns its program, so it can be moved but not copied. Use ProgramRegistry to
+    //share a program between several users.
+    ShaderLoader(const ShaderLoader&) = delete;
+    ShaderLoader& operator=(const ShaderLoader&) = delete;
+
+    ShaderLoader(ShaderLoader&& other) :
+        vertexPath{NULL}, fragmentPath{NULL}
     {
-        std::string vertexCode = loadShader(vertexPath);
-        std::string fragmentCode = loadShader(fragmentPath);
+        moveFrom(other);
+    }
 
-        auto vertexShaderId = glCreateShader(GL_VERTEX_SHADER);
-        const char* vertexCodeC = vertexCode.c_str();
-        glShaderSource(vertexShaderId, 1, &vertexCodeC, NULL);
-        if (!compileShader(vertexShaderId))
+    ShaderLoader& operator=(ShaderLoader&& other)
+    {
+        if (this != &other)
         {
-            std::string message = getCompileErrorMessage(vertexShaderId);
-            throw("Vertex Shader Compilation Error: " + message);
+            release();
+            moveFrom(other);
         }
+        return *this;
+    }
+
+    //Deletes the program in the current context, so don't destroy it while another context is
+    //current
+    ~ShaderLoader()
+    {
+        release();
+    }
 
-        auto fragmentShaderId = glCreateShader(GL_FRAGMENT_SHADER);
-        const char* fragmentCodeC = fragmentCode.c_str();
-        glShaderSource(fragmentShaderId, 1, &fragmentCodeC, NULL);
-        if (!compileShader(fragmentShaderId))
+    //Compiles and links the shaders and waits for the result. Throws a string on failure.
+    void linkShaders()
+    {
+        beginLink();
+        finishLink();
+    }
+
+    //Submits compile and link without asking for their status, so the driver can build several
+    //programs at the same time (see ShaderBatch). Call finishLink() to get the result. If you
+    //don't, use() and getProgramId() call it.
+    void beginLink()
+    {
+        //Files on disk are mapped into memory and passed to glShaderSource with their length,
+        //so they are not copied. Embedded and in-memory sources are used as they are.
+        MappedFile vertexFile, fragmentFile;
+        auto vertexCode = vertexPath != NULL ? loadShaderSource(vertexPath, vertexFile) : vertexSource;
+        auto fragmentCode = fragmentPath != NULL ? loadShaderSource(fragmentPath, fragmentFile) : fragmentSource;
+
+        //Try the program binary cache first. If the binary is missing or stale, we fall back
+        //to compiling from the source.
+        useBinaryCache = binaryCacheEnabled && ProgramBinaryCache::isSupported();
+        if (useBinaryCache)
         {
-            std::string message = getCompileErrorMessage(fragmentShaderId);
-            throw("Fragment Shader Compilation Error: " + message);
+            binaryKey = ProgramBinaryCache::makeKey(vertexCode, fragmentCode, defines);
+            programId = glCreateProgram();
+            if (ProgramBinaryCache().load(programId, binaryKey))
+            {
+                bindUniformBlocks();
+                reflectUniforms();
+                linkState = LinkState::Linked;
+                return;
+            }
+            glDeleteProgram(programId);
         }
 
+        vertexShaderId = glCreateShader(GL_VERTEX_SHADER);
+        setShaderSource(vertexShaderId, vertexCode);
+        glCompileShader(vertexShaderId);
+
+        fragmentShaderId = glCreateShader(GL_FRAGMENT_SHADER);
+        setShaderSource(fragmentShaderId, fragmentCode);
+        glCompileShader(fragmentShaderId);
+
         programId = glCreateProgram();
         glAttachShader(programId, vertexShaderId);
         glAttachShader(programId, fragmentShaderId);
-        if (!linkShadersHelper())
-            throw ("Linking shaders error: " + getLinkErrorMessage());
+        if (useBinaryCache)
+            ProgramBinaryCache::setRetrievableHint(programId);
+        glLinkProgram(programId);
+        linkState = LinkState::Pending;
+    }
+
+    //Returns true if finishLink() doesn't block. The driver can only tell it with
+    //GL_KHR_parallel_shader_compile, so without the extension it's always true.
+    bool isLinkComplete() const
+    {
+        if (linkState != LinkState::Pending || !isParallelShaderCompileSupported())
+            return true;
+        GLint completed = 0;
+        glGetProgramiv(programId, GLEXT_COMPLETION_STATUS, &completed);
+        return completed != 0;
+    }
+
+    //Waits for the link submitted by beginLink() and checks the result. Throws a string on failure.
+    void finishLink()
+    {
+        if (linkState != LinkState::Pending)
+            return;
+        linkState = LinkState::Failed;
+        if (!getCompileStatus(vertexShaderId))
+            failLink("Vertex Shader Compilation Error: " + getCompileErrorMessage(vertexShaderId));
+        if (!getCompileStatus(fragmentShaderId))
+            failLink("Fragment Shader Compilation Error: " + getCompileErrorMessage(fragmentShaderId));
+        if (!getLinkStatus())
+            failLink("Linking shaders error: " + getLinkErrorMessage());
         glDeleteShader(vertexShaderId);
         glDeleteShader(fragmentShaderId);
+        vertexShaderId = 0;
+        fragmentShaderId = 0;
+        if (useBinaryCache)
+            ProgramBinaryCache().store(programId, binaryKey);
+        bindUniformBlocks();
+        reflectUniforms();
+        linkState = LinkState::Linked;
+    }
+
+    //Adds "#define name value" to both shaders after their #version line. Call it before
+    //linkShaders() or beginLink(). See ShaderVariantCache for building several variants of the
+    //same code.
+    void addDefine(const std::string& name, const std::string& value = "")
+    {
+        defines += "#define " + name + " " + value + "\n";
+    }
+
+    //The binary cache is enabled by default. Disable it before linkShaders() to always
+    //compile from the source.
+    void setBinaryCacheEnabled(bool enabled)
+    {
+        binaryCacheEnabled = enabled;
     }
 
+    //Builds the program again from the files and replaces the current one only if it compiles and
+    //links, so a broken edit keeps the last working program. Uniform values set through the
+    //setters are uploaded to the new program. The files are always read from disk, even in a
+    //build with embedded shaders. Returns false and the error message on failure.
+    //
+    //The new program is bound to upload the values. With state it's bound through the cache and
+    //stays bound. Without it the previous program is bound again directly, so call
+    //GLStateCache::invalidate() afterwards if you use a cache.
+    bool reload(std::string& error, GLStateCache* state = NULL)
+    {
+        if (vertexPath == NULL || fragmentPath == NULL)
+        {
+            error = "Cannot reload shaders which are not loaded from files";
+            return false;
+        }
+        finishLink();
+
+        //The files are copied rather than mapped, since the editor may still be writing them
+        std::string vertexCode, fragmentCode;
+        try
+        {
+            vertexCode = readShaderFile(vertexPath);
+            fragmentCode = readShaderFile(fragmentPath);
+        }
+        catch (std::string str)
+        {
+            error = str;
+            return false;
+        }
+
+        ShaderLoader newShader(std::move(vertexCode), std::move(fragmentCode));
+        newShader.defines = defines;
+        newShader.binaryCacheEnabled = binaryCacheEnabled;
+        try
+        {
+            newShader.linkShaders();
+        }
+        catch (std::string str)
+        {
+            error = str;
+            return false;
+        }
+        catch (std::exception& e)
+        {
+            error = e.what();
+            return false;
+        }
+
+        GLint currentProgram = 0;
+        if (state != NULL)
+            state->useProgram(newShader.programId);
+        else
+        {
+            glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
+            glUseProgram(newShader.programId);
+        }
+        for (const auto& value : uniformValues)
+        {
+            auto newValue = newShader.findUniform(value.hash);
+            if (value.uploaded && newValue != NULL)
+                newShader.uploadUniformValue(*newValue, value.type, value.data);
+        }
+        if (state == NULL)
+        {
+            bool isCurrent = static_cast<GLuint>(currentProgram) == programId;
+            glUseProgram(isCurrent ? newShader.programId : static_cast<GLuint>(currentProgram));
+        }
+
+        glDeleteProgram(programId);
+        programId = newShader.programId;
+        newShader.programId = 0;
+        uniforms.swap(newShader.uniforms);
+        uniformValues.swap(newShader.uniformValues);
+        return true;
+    }
+
+    const char* getVertexPath() const
+    {
+        return vertexPath;
+    }
+
+    //The code given to the constructor, empty if the shaders are loaded from files
+    ShaderSource getVertexSource() const
+    {
+        return vertexSource;
+    }
+
+    ShaderSource getFragmentSource() const
+    {
+        return fragmentSource;
+    }
+
+    const char* getFragmentPath() const
+    {
+        return fragmentPath;
+    }
+
+    //Binds the program directly. If you bind programs through a GLStateCache, use the overload
+    //below, otherwise the cache may skip the next bind of another program.
     void use()
     {
+        finishLink();
         glUseProgram(programId);
     }
+
+    void use(GLStateCache& state)
+    {
+        finishLink();
+        state.useProgram(programId);
+    }
     
     GLuint getProgramId()
     {
+        finishLink();
         return programId;
     }
 
+    //Returns -1 if the program has no active uniform with this name. Uniform locations are
+    //queried once after linking, so it doesn't call glGetUniformLocation.
+    GLint getUniformLocation(UniformName name) const
+    {
+        auto uniform = findUniform(name.hash);
+        return uniform != NULL ? uniform->location : -1;
+    }
+
+    //The setters upload to the current program, so call use() first.
+    //
+    //ShaderLoader keeps a copy of the last value uploaded to each uniform and the setters don't
+    //call glUniform* if the new value is bit-identical to it. If you change a uniform directly
+    //by glUniform*, call invalidateUniformValues() afterwards.
+    void setInt(UniformName name, GLint value)
+    {
+        auto uniform = findUniform(name.hash);
+        if (uniform != NULL && updateUniformValue(*uniform, UniformType::Int, &value, sizeof(value)))
+            glUniform1i(uniform->location, value);
+    }
+
+    void setFloat(UniformName name, GLfloat value)
+    {
+        auto uniform = findUniform(name.hash);
+        if (uniform != NULL && updateUniformValue(*uniform, UniformType::Float, &value, sizeof(value)))
+            glUniform1f(uniform->location, value);
+    }
+
+    void setMat4(UniformName name, const glm::mat4& value)
+    {
+        auto uniform = findUniform(name.hash);
+        if (uniform != NULL && updateUniformValue(*uniform, UniformType::Mat4, glm::value_ptr(value), sizeof(value)))
+            glUniformMatrix4fv(uniform->location, 1, GL_FALSE, glm::value_ptr(value));
+    }
+
+    void invalidateUniformValues()
+    {
+        for (auto& uniform : uniformValues)
+            uniform.uploaded = false;
+    }
+
+    struct UniformStats
+    {
+        unsigned int uploaded;
+        unsigned int elided;
+    };
+
+    //Number of uploads issued and skipped by the setters since the last resetUniformStats().
+    //Call resetUniformStats() at the beginning of each frame to get per-frame numbers.
+    UniformStats getUniformStats() const
+    {
+        return uniformStats;
+    }
+
+    void resetUniformStats()
+    {
+        uniformStats.uploaded = 0;
+        uniformStats.elided = 0;
+    }
+
 private:
-    std::string loadShader(const char* shaderPath)
+    struct UniformInfo
+    {
+        std::uint64_t hash;
+        std::size_t valueIndex;
+    };
+
+    //The setter which uploaded the value
+    enum class UniformType
+    {
+        Int,
+        Float,
+        Mat4
+    };
+
+    //Big enough for the largest type we have a setter for
+    struct UniformValue
+    {
+        std::uint64_t hash;
+        GLint location;
+        bool uploaded;
+        UniformType type;
+        unsigned char data[sizeof(glm::mat4)];
+    };
+
+    const UniformValue* findUniform(std::uint64_t hash) const
+    {
+        if (uniforms.empty())
+            return NULL;
+        std::size_t mask = uniforms.size() - 1;
+        auto i = static_cast<std::size_t>(hash) & mask;
+        for (std::size_t probe = 0; probe < uniforms.size(); ++probe, i = (i + 1) & mask)
+        {
+            if (uniforms[i].hash == hash)
+                return &uniformValues[uniforms[i].valueIndex];
+            if (uniforms[i].hash == 0)
+                return NULL;
+        }
+        return NULL;
+    }
+
+    UniformValue* findUniform(std::uint64_t hash)
+    {
+        return const_cast<UniformValue*>(static_cast<const ShaderLoader*>(this)->findUniform(hash));
+    }
+
+    //Returns false if the value is the same as the last uploaded one
+    bool updateUniformValue(UniformValue& uniform, UniformType type, const void* value, std::size_t size)
+    {
+        if (uniform.uploaded && uniform.type == type && std::memcmp(uniform.data, value, size) == 0)
+        {
+            ++uniformStats.elided;
+            return false;
+        }
+        std::memcpy(uniform.data, value, size);
+        uniform.uploaded = true;
+        uniform.type = type;
+        ++uniformStats.uploaded;
+        return true;
+    }
+
+    //Uploads a value saved by another program (see reload())
+    void uploadUniformValue(UniformValue& uniform, UniformType type, const unsigned char* data)
     {
-        std::ifstream shaderFile;
+        switch (type)
+        {
+        case UniformType::Int:
+            {
+                GLint value;
+                std::memcpy(&value, data, sizeof(value));
+                setInt(UniformName(uniform.hash), value);
+            }
+            break;
+        case UniformType::Float:
+            {
+                GLfloat value;
+                std::memcpy(&value, data, sizeof(value));
+                setFloat(UniformName(uniform.hash), value);
+            }
+            break;
+        case UniformType::Mat4:
+            {
+                glm::mat4 value;
+                std::memcpy(glm::value_ptr(value), data, sizeof(value));
+                setMat4(UniformName(uniform.hash), value);
+            }
+            break;
+        }
+    }
 
-        shaderFile.exceptions(std::ifstream::badbit | std::ifstream::failbit);
-        shaderFile.open(shaderPath);
+    //Deletes the objects of a failed link and throws the message
+    void failLink(const std::string& message)
+    {
+        glDeleteShader(vertexShaderId);
+        glDeleteShader(fragmentShaderId);
+        glDeleteProgram(programId);
+        vertexShaderId = fragmentShaderId = programId = 0;
+        throw message;
+    }
 
-        std::ostringstream os;
-        os << shaderFile.rdbuf();
-        return os.str();
+    void bindUniformBlocks()
+    {
+        for (const auto& block : uniformBlockBindings)
+        {
+            auto index = glGetUniformBlockIndex(programId, block.name);
+            if (index != GL_INVALID_INDEX)
+                glUniformBlockBinding(programId, index, block.binding);
+        }
     }
 
-    GLint compileShader(GLuint shader)
+    //Stores the location of active uniforms in an open addressing table. An array has two entries,
+    //"name[0]" and "name", so the table is at least four times the number of uniforms and at most
+    //half full.
+    void reflectUniforms()
+    {
+        uniforms.clear();
+        uniformValues.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(programId, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(programId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        if (count <= 0)
+            return;
+
+        std::size_t tableSize = 1;
+        while (tableSize < 4 * static_cast<std::size_t>(count))
+            tableSize <<= 1;
+        UniformInfo empty = {0, 0};
+        uniforms.assign(tableSize, empty);
+
+        std::unique_ptr<GLchar[]> name(new GLchar[maxLength + 1]);
+        for (GLint i = 0; i < count; ++i)
+        {
+            GLint size;
+            GLenum type;
+            glGetActiveUniform(programId, static_cast<GLuint>(i), maxLength + 1, NULL, &size, &type, name.get());
+            auto location = glGetUniformLocation(programId, name.get());
+            if (location < 0) //Uniforms of uniform blocks
+                continue;
+            UniformValue value;
+            value.hash = hashString(name.get());
+            value.location = location;
+            value.uploaded = false;
+            uniformValues.push_back(value);
+            insertUniform(hashString(name.get()), uniformValues.size() - 1);
+            //Arrays are reported as "name[0]", but we want to find them by "name" too
+            std::string arrayName(name.get());
+            if (arrayName.size() > 3 && arrayName.compare(arrayName.size() - 3, 3, "[0]") == 0)
+                insertUniform(hashString(arrayName.substr(0, arrayName.size() - 3).c_str()), uniformValues.size() - 1);
+        }
+    }
+
+    void insertUniform(std::uint64_t hash, std::size_t valueIndex)
+    {
+        std::size_t mask = uniforms.size() - 1;
+        auto i = static_cast<std::size_t>(hash) & mask;
+        while (uniforms[i].hash != 0 && uniforms[i].hash != hash)
+            i = (i + 1) & mask;
+        uniforms[i].hash = hash;
+        uniforms[i].valueIndex = valueIndex;
+    }
+
+    //The chapters destroy their shaders after glfwTerminate(). The context deleted the objects
+    //with it, so there's nothing to release then.
+    void release()
+    {
+        if (glfwGetCurrentContext() == NULL)
+        {
+            vertexShaderId = fragmentShaderId = programId = 0;
+            linkState = LinkState::NotLinked;
+            return;
+        }
+        if (vertexShaderId != 0)
+            glDeleteShader(vertexShaderId);
+        if (fragmentShaderId != 0)
+            glDeleteShader(fragmentShaderId);
+        if (programId != 0)
+            glDeleteProgram(programId);
+        vertexShaderId = 0;
+        fragmentShaderId = 0;
+        programId = 0;
+        linkState = LinkState::NotLinked;
+    }
+
+    //Takes the GL objects of other and leaves it empty
+    void moveFrom(ShaderLoader& other)
+    {
+        programId = other.programId;
+        vertexPath = other.vertexPath;
+        fragmentPath = other.fragmentPath;
+        vertexSource = other.vertexSource;
+        fragmentSource = other.fragmentSource;
+        //Short strings are stored in the string itself, so the views must point to our copy
+        ownsSources = other.ownsSources;
+        if (ownsSources)
+        {
+            vertexCode = std::move(other.vertexCode);
+            fragmentCode = std::move(other.fragmentCode);
+            vertexSource = ShaderSource(vertexCode);
+            fragmentSource = ShaderSource(fragmentCode);
+            other.vertexSource = other.fragmentSource = ShaderSource();
+        }
+        defines = std::move(other.defines);
+        vertexShaderId = other.vertexShaderId;
+        fragmentShaderId = other.fragmentShaderId;
+        linkState = other.linkState;
+        binaryCacheEnabled = other.binaryCacheEnabled;
+        useBinaryCache = other.useBinaryCache;
+        binaryKey = std::move(other.binaryKey);
+        uniforms = std::move(other.uniforms);
+        uniformValues = std::move(other.uniformValues);
+        uniformStats = other.uniformStats;
+
+        other.programId = 0;
+        other.vertexShaderId = 0;
+        other.fragmentShaderId = 0;
+        other.linkState = LinkState::NotLinked;
+    }
+
+    //The defines must come after #version, so instead of concatenating the code, we pass three
+    //strings: the #version line, the defines and the rest of the code.
+    void setShaderSource(GLuint shader, ShaderSource source)
+    {
+        if (defines.empty())
+        {
+            auto length = static_cast<GLint>(source.size);
+            glShaderSource(shader, 1, &source.data, &length);
+            return;
+        }
+        auto versionLength = getVersionLineLength(source);
+        const GLchar* strings[3] = {source.data, defines.data(), source.data + versionLength};
+        GLint lengths[3] =
+        {
+            static_cast<GLint>(versionLength),
+            static_cast<GLint>(defines.size()),
+            static_cast<GLint>(source.size - versionLength)
+        };
+        glShaderSource(shader, 3, strings, lengths);
+    }
+
+    //Returns 0 if the code doesn't start with #version
+    static std::size_t getVersionLineLength(ShaderSource source)
+    {
+        const char version[] = "#version";
+        if (source.size < sizeof(version) - 1 || std::strncmp(source.data, version, sizeof(version) - 1) != 0)
+            return 0;
+        auto end = static_cast<const char*>(std::memchr(source.data, '\n', source.size));
+        return end != NULL ? static_cast<std::size_t>(end - source.data) + 1 : source.size;
+    }
+
+    GLint getCompileStatus(GLuint shader)
     {
-        glCompileShader(shader);
         GLint success;
         glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
         return success;
@@ -92,9 +658,8 @@ private:
         return std::string(message.get());
     }
 
-    GLint linkShadersHelper()
+    GLint getLinkStatus()
     {
-        glLinkProgram(programId);
         GLint success;
         glGetProgramiv(programId, GL_LINK_STATUS, &success);
         return success;
@@ -112,8 +677,28 @@ private:
     }
 
 private:
-    GLuint programId;
+    enum class LinkState
+    {
+        NotLinked,
+        Pending,
+        Linked,
+        Failed
+    };
+
+    GLuint programId = 0;
     const char* vertexPath, * fragmentPath;
+    ShaderSource vertexSource, fragmentSource;
+    std::string vertexCode, fragmentCode;
+    bool ownsSources = false;
+    std::string defines;
+    GLuint vertexShaderId = 0, fragmentShaderId = 0;
+    LinkState linkState = LinkState::NotLinked;
+    bool binaryCacheEnabled = true;
+    bool useBinaryCache = false;
+    std::string binaryKey;
+    std::vector<UniformInfo> uniforms;
+    std::vector<UniformValue> uniformValues;
+    UniformStats uniformStats = {0, 0};
 };
 
 #endif
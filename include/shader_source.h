@@ -0,0 +1,102 @@
+#ifndef SHADER_SOURCE_H
+#define SHADER_SOURCE_H
+
+#include <mapped_file.h>
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstddef>
+#include <cstring>
+
+//A non-owning view of shader source code. The code doesn't need to be null-terminated, since
+//we pass its length to glShaderSource.
+struct ShaderSource
+{
+    constexpr ShaderSource() :
+        data{NULL}, size{0}
+    {
+    }
+
+    constexpr ShaderSource(const char* data, std::size_t size) :
+        data{data}, size{size}
+    {
+    }
+
+    template <std::size_t N>
+    constexpr ShaderSource(const char (&str)[N]) :
+        data{str}, size{N - 1}
+    {
+    }
+
+    explicit ShaderSource(const std::string& str) :
+        data{str.data()}, size{str.size()}
+    {
+    }
+
+    const char* data;
+    std::size_t size;
+};
+
+//Shaders compiled into the executable by embed_shaders() in CMake. The path is the one we
+//would open at run time, e.g. "shaders/shader.vs".
+struct EmbeddedShader
+{
+    const char* path;
+    ShaderSource source;
+};
+
+#ifdef EMBED_SHADERS
+#include <embedded_shaders.h>
+
+//Returns false if the file is not embedded
+inline bool findEmbeddedShader(const char* path, ShaderSource& source)
+{
+    for (const auto& shader : embeddedShaders)
+    {
+        if (std::strcmp(shader.path, path) == 0)
+        {
+            source = shader.source;
+            return true;
+        }
+    }
+    return false;
+}
+#else
+inline bool findEmbeddedShader(const char*, ShaderSource&)
+{
+    return false;
+}
+#endif
+
+//Returns the embedded copy of the file if there is one and readEmbedded is set, otherwise maps
+//the file into memory and returns a view of the mapping, which is valid while file lives.
+//Throws a string if the file cannot be read.
+inline ShaderSource loadShaderSource(const char* path, MappedFile& file, bool readEmbedded = true)
+{
+    ShaderSource source;
+    if (readEmbedded && findEmbeddedShader(path, source))
+        return source;
+
+    if (!file.open(path))
+        throw std::string("Cannot read ") + path;
+    return file.getData() != NULL ? ShaderSource(file.getData(), file.getSize()) : ShaderSource("");
+}
+
+//Reads a copy of the file from disk, ignoring the embedded copy. Use it for files which may be
+//rewritten while we read them, e.g. by an editor during hot reload: an editor can truncate the
+//file, and reading a mapping past the new end of the file raises SIGBUS. Throws a string if the
+//file cannot be read.
+inline std::string readShaderFile(const char* path)
+{
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file)
+        throw std::string("Cannot read ") + path;
+    std::ostringstream os;
+    os << file.rdbuf();
+    if (file.bad())
+        throw std::string("Cannot read ") + path;
+    return os.str();
+}
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <shader_loader.h>
+#include <shader_batch.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <unordered_map>
+
+struct ShaderDefine
+{
+    std::string name;
+    std::string value;
+};
+
+//Builds variants of the same shader code with different #defines, e.g. a constant instead of
+//a uniform, so the driver can fold it instead of reading a uniform on each fragment. A variant
+//is identified by the shader files and the set of defines (their order doesn't matter) and is
+//compiled only the first time it's requested. The variants live as long as the cache and don't
+//move, so the references can be kept, e.g. in a table indexed by a setting.
+//
+//Build the variants you know up front with prefetch(), which submits them to a batch so the
+//driver compiles them together:
+//
+//    ShaderVariantCache variants;
+//    ShaderBatch batch;
+//    auto& shader = variants.prefetch("shaders/shader.vs", "shaders/shader.fs", batch, {{"MIX_FACTOR", "0.5"}});
+//    ...
+//    batch.finishAll();
+//
+//get() throws a string if the variant cannot be built, like ShaderLoader::linkShaders(). The
+//errors of prefetched variants are thrown by the batch.
+class ShaderVariantCache
+{
+public:
+    ShaderLoader& get(const char* vertexPath, const char* fragmentPath, std::vector<ShaderDefine> defines = std::vector<ShaderDefine>())
+    {
+        std::string key;
+        if (auto shader = find(vertexPath, fragmentPath, defines, key))
+            return *shader;
+        auto variant = makeVariant(vertexPath, fragmentPath, defines);
+        variant->shader.linkShaders();
+        return insert(key, std::move(variant));
+    }
+
+    //Like get(), but a new variant is submitted to the batch instead of being linked. It's ready
+    //once the batch finishes it.
+    ShaderLoader& prefetch(const char* vertexPath, const char* fragmentPath, ShaderBatch& batch, std::vector<ShaderDefine> defines = std::vector<ShaderDefine>())
+    {
+        std::string key;
+        if (auto shader = find(vertexPath, fragmentPath, defines, key))
+            return *shader;
+        auto& shader = insert(key, makeVariant(vertexPath, fragmentPath, defines));
+        batch.add(shader);
+        return shader;
+    }
+
+    std::size_t getVariantCount() const
+    {
+        return variants.size();
+    }
+
+private:
+    //Keeps a copy of the paths, since ShaderLoader only stores the pointers
+    struct Variant
+    {
+        Variant(const std::string& vertexPath, const std::string& fragmentPath) :
+            vertexPath{vertexPath}, fragmentPath{fragmentPath}, shader{this->vertexPath.c_str(), this->fragmentPath.c_str()}
+        {
+        }
+
+        std::string vertexPath, fragmentPath;
+        ShaderLoader shader;
+    };
+
+    //Sorts the defines and returns the variant or NULL, with the key to insert it
+    ShaderLoader* find(const char* vertexPath, const char* fragmentPath, std::vector<ShaderDefine>& defines, std::string& key)
+    {
+        std::sort(defines.begin(), defines.end(), [](const ShaderDefine& a, const ShaderDefine& b)
+        {
+            return a.name < b.name;
+        });
+        key = makeKey(vertexPath, fragmentPath, defines);
+        auto it = variants.find(key);
+        return it != variants.end() ? &it->second->shader : NULL;
+    }
+
+    static std::unique_ptr<Variant> makeVariant(const char* vertexPath, const char* fragmentPath, const std::vector<ShaderDefine>& defines)
+    {
+        std::unique_ptr<Variant> variant(new Variant(vertexPath, fragmentPath));
+        for (const auto& define : defines)
+            variant->shader.addDefine(define.name, define.value);
+        return variant;
+    }
+
+    ShaderLoader& insert(const std::string& key, std::unique_ptr<Variant> variant)
+    {
+        auto& shader = variant->shader;
+        variants[key] = std::move(variant);
+        return shader;
+    }
+
+    static std::string makeKey(const char* vertexPath, const char* fragmentPath, const std::vector<ShaderDefine>& defines)
+    {
+        std::string key = vertexPath;
+        key += '\n';
+        key += fragmentPath;
+        for (const auto& define : defines)
+            key += '\n' + define.name + '=' + define.value;
+        return key;
+    }
+
+private:
+    std::unordered_map<std::string, std::unique_ptr<Variant>> variants;
+};
+
+#endif
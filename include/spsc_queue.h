@@ -0,0 +1,62 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+//Lock-free bounded queue for exactly one producer thread and one consumer thread. The capacity
+//is rounded up to a power of two. push() returns false instead of blocking when it's full.
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(std::size_t capacity) :
+        buffer(roundUpToPowerOfTwo(capacity)), mask{buffer.size() - 1}, head{0}, tail{0}
+    {
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    //Producer thread only
+    bool push(const T& value)
+    {
+        auto currentTail = tail.load(std::memory_order_relaxed);
+        if (currentTail - head.load(std::memory_order_acquire) == buffer.size())
+            return false;
+        buffer[currentTail & mask] = value;
+        tail.store(currentTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    //Consumer thread only
+    bool pop(T& value)
+    {
+        auto currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead == tail.load(std::memory_order_acquire))
+            return false;
+        value = buffer[currentHead & mask];
+        head.store(currentHead + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    static std::size_t roundUpToPowerOfTwo(std::size_t value)
+    {
+        std::size_t result = 1;
+        while (result < value)
+            result <<= 1;
+        return result;
+    }
+
+private:
+    std::vector<T> buffer;
+    const std::size_t mask;
+    //head and tail are on their own cache lines, so the threads don't invalidate each other's
+    //line on each operation
+    alignas(64) std::atomic<std::size_t> head;
+    alignas(64) std::atomic<std::size_t> tail;
+};
+
+#endif
@@ -0,0 +1,553 @@
+#ifndef TRANSFORM_BATCH_H
+#define TRANSFORM_BATCH_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+//SSE2 is always there on x86-64. The AVX2 kernel is compiled for its target and picked at run
+//time, so the programs still run on CPUs without it.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRANSFORM_BATCH_SSE
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+#include <immintrin.h>
+#define TRANSFORM_BATCH_AVX2
+#define TRANSFORM_BATCH_AVX2_TARGET __attribute__((target("avx2,fma")))
+#elif defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#define TRANSFORM_BATCH_AVX2
+#define TRANSFORM_BATCH_AVX2_TARGET
+#endif
+#endif
+
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+
+//The instruction sets of computeTransforms
+enum class TransformKernel
+{
+    Scalar,
+    Sse,
+    Avx2
+};
+
+//Mat4 is 16 floats per instance like glm::mat4, column by column. Mat3x4 drops the last row,
+//which is always (0, 0, 0, 1), and stores the other three, 12 floats.
+enum class TransformLayout
+{
+    Mat4,
+    Mat3x4
+};
+
+inline bool isTransformKernelSupported(TransformKernel kernel)
+{
+    switch (kernel)
+    {
+    case TransformKernel::Scalar:
+        return true;
+    case TransformKernel::Sse:
+#if defined(TRANSFORM_BATCH_SSE)
+        return true;
+#else
+        return false;
+#endif
+    case TransformKernel::Avx2:
+    {
+#if defined(TRANSFORM_BATCH_AVX2) && defined(_MSC_VER)
+        static const bool supported = []()
+        {
+            int info[4];
+            __cpuid(info, 1);
+            //FMA, OSXSAVE and AVX, then the OS must save the YMM registers
+            const int features = (1 << 12) | (1 << 27) | (1 << 28);
+            if ((info[2] & features) != features || (_xgetbv(0) & 6) != 6)
+                return false;
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+        }();
+        return supported;
+#elif defined(TRANSFORM_BATCH_AVX2)
+        static const bool supported = []()
+        {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        }();
+        return supported;
+#else
+        return false;
+#endif
+    }
+    }
+    return false;
+}
+
+//The fastest kernel this CPU runs
+inline TransformKernel getTransformKernel()
+{
+    if (isTransformKernelSupported(TransformKernel::Avx2))
+        return TransformKernel::Avx2;
+    if (isTransformKernelSupported(TransformKernel::Sse))
+        return TransformKernel::Sse;
+    return TransformKernel::Scalar;
+}
+
+inline const char* getTransformKernelName(TransformKernel kernel)
+{
+    switch (kernel)
+    {
+    case TransformKernel::Scalar:
+        return "scalar";
+    case TransformKernel::Sse:
+        return "SSE";
+    case TransformKernel::Avx2:
+        return "AVX2";
+    }
+    return "";
+}
+
+//Instances placed by a position and rotated by an angle in radians around an axis, in structure
+//of arrays layout. The model matrix of one is
+//
+//    glm::rotate(glm::translate(glm::mat4(), position), angle, axis)
+//
+//and computeTransforms makes 4 or 8 of them at once. Animations change the angles in place:
+//
+//    for (auto i : animatedCubes)
+//        transforms.getAngles()[i] = baseAngles[i] + time;
+//    transforms.compute(models);
+class TransformBatch
+{
+public:
+    void reserve(std::size_t instanceNumber)
+    {
+        for (auto array : {&positionX, &positionY, &positionZ, &axisX, &axisY, &axisZ, &angles})
+            array->reserve(instanceNumber);
+    }
+
+    void clear()
+    {
+        for (auto array : {&positionX, &positionY, &positionZ, &axisX, &axisY, &axisZ, &angles})
+            array->clear();
+    }
+
+    //The axis doesn't need to be normalized
+    std::uint32_t add(const glm::vec3& position, const glm::vec3& axis, float angle)
+    {
+        positionX.push_back(0.0f);
+        positionY.push_back(0.0f);
+        positionZ.push_back(0.0f);
+        axisX.push_back(1.0f);
+        axisY.push_back(0.0f);
+        axisZ.push_back(0.0f);
+        angles.push_back(0.0f);
+        auto index = static_cast<std::uint32_t>(angles.size() - 1);
+        set(index, position, axis, angle);
+        return index;
+    }
+
+    void set(std::uint32_t index, const glm::vec3& position, const glm::vec3& axis, float angle)
+    {
+        positionX[index] = position.x;
+        positionY[index] = position.y;
+        positionZ[index] = position.z;
+        float length = std::sqrt(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+        axisX[index] = axis.x / length;
+        axisY[index] = axis.y / length;
+        axisZ[index] = axis.z / length;
+        angles[index] = angle;
+    }
+
+    std::size_t size() const
+    {
+        return angles.size();
+    }
+
+    const float* getPositionX() const
+    {
+        return positionX.data();
+    }
+
+    const float* getPositionY() const
+    {
+        return positionY.data();
+    }
+
+    const float* getPositionZ() const
+    {
+        return positionZ.data();
+    }
+
+    const float* getAxisX() const
+    {
+        return axisX.data();
+    }
+
+    const float* getAxisY() const
+    {
+        return axisY.data();
+    }
+
+    const float* getAxisZ() const
+    {
+        return axisZ.data();
+    }
+
+    float* getAngles()
+    {
+        return angles.data();
+    }
+
+    const float* getAngles() const
+    {
+        return angles.data();
+    }
+
+    //All the model matrices with the fastest kernel, models must have room for size() of them
+    void compute(glm::mat4* models) const;
+
+private:
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> axisX, axisY, axisZ;
+    std::vector<float> angles;
+};
+
+//The 9 rotation elements of glm::rotate, column by column
+inline void getRotation(float x, float y, float z, float sine, float cosine, float* rotation)
+{
+    float t = 1.0f - cosine;
+    rotation[0] = cosine + t * x * x;
+    rotation[1] = t * x * y + sine * z;
+    rotation[2] = t * x * z - sine * y;
+    rotation[3] = t * x * y - sine * z;
+    rotation[4] = cosine + t * y * y;
+    rotation[5] = t * y * z + sine * x;
+    rotation[6] = t * x * z + sine * y;
+    rotation[7] = t * y * z - sine * x;
+    rotation[8] = cosine + t * z * z;
+}
+
+inline void computeTransformsScalar(const TransformBatch& batch, std::size_t begin, std::size_t end, float* out, TransformLayout layout)
+{
+    auto positionX = batch.getPositionX(), positionY = batch.getPositionY(), positionZ = batch.getPositionZ();
+    auto axisX = batch.getAxisX(), axisY = batch.getAxisY(), axisZ = batch.getAxisZ();
+    auto angles = batch.getAngles();
+    for (auto i = begin; i < end; ++i)
+    {
+        float r[9];
+        getRotation(axisX[i], axisY[i], axisZ[i], std::sin(angles[i]), std::cos(angles[i]), r);
+        if (layout == TransformLayout::Mat4)
+        {
+            const float model[16] = {r[0], r[1], r[2], 0.0f, r[3], r[4], r[5], 0.0f, r[6], r[7], r[8], 0.0f,
+                positionX[i], positionY[i], positionZ[i], 1.0f};
+            std::memcpy(out, model, sizeof(model));
+            out += 16;
+        }
+        else
+        {
+            const float model[12] = {r[0], r[3], r[6], positionX[i], r[1], r[4], r[7], positionY[i],
+                r[2], r[5], r[8], positionZ[i]};
+            std::memcpy(out, model, sizeof(model));
+            out += 12;
+        }
+    }
+}
+
+//The SIMD kernels share the sine and cosine: the angle is reduced to [-pi/4, pi/4] around the
+//nearest multiple of pi/2 in three steps (Cody-Waite), then the minimax polynomials of
+//Cephes' sinf and cosf give about 1e-7 of error. Angles should stay within about 1e5.
+const float sinCosTwoOverPi = 0.636619772f;
+const float sinCosHalfPi1 = 1.5703125f;
+const float sinCosHalfPi2 = 4.837512969970703125e-4f;
+const float sinCosHalfPi3 = 7.54978995489188216e-8f;
+const float sinCosSine1 = -1.6666654611e-1f, sinCosSine2 = 8.3321608736e-3f, sinCosSine3 = -1.9515295891e-4f;
+const float sinCosCosine1 = 4.166664568298827e-2f, sinCosCosine2 = -1.388731625493765e-3f, sinCosCosine3 = 2.443315711809948e-5f;
+
+#if defined(TRANSFORM_BATCH_SSE)
+inline void sinCosSse(__m128 angle, __m128& sine, __m128& cosine)
+{
+    auto quadrant = _mm_cvtps_epi32(_mm_mul_ps(angle, _mm_set1_ps(sinCosTwoOverPi)));
+    auto multiple = _mm_cvtepi32_ps(quadrant);
+    auto x = _mm_sub_ps(angle, _mm_mul_ps(multiple, _mm_set1_ps(sinCosHalfPi1)));
+    x = _mm_sub_ps(x, _mm_mul_ps(multiple, _mm_set1_ps(sinCosHalfPi2)));
+    x = _mm_sub_ps(x, _mm_mul_ps(multiple, _mm_set1_ps(sinCosHalfPi3)));
+    auto x2 = _mm_mul_ps(x, x);
+
+    auto sinePolynomial = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(sinCosSine3), x2), _mm_set1_ps(sinCosSine2));
+    sinePolynomial = _mm_add_ps(_mm_mul_ps(sinePolynomial, x2), _mm_set1_ps(sinCosSine1));
+    sinePolynomial = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sinePolynomial, x2), x), x);
+    auto cosinePolynomial = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(sinCosCosine3), x2), _mm_set1_ps(sinCosCosine2));
+    cosinePolynomial = _mm_add_ps(_mm_mul_ps(cosinePolynomial, x2), _mm_set1_ps(sinCosCosine1));
+    cosinePolynomial = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(cosinePolynomial, x2), x2),
+        _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), x2)));
+
+    //Odd quadrants swap the two, quadrants 2 and 3 negate the sine, 1 and 2 the cosine
+    auto swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    auto sineSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(2)), 30));
+    auto cosineSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, _mm_set1_epi32(1)),
+        _mm_set1_epi32(2)), 30));
+    sine = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, cosinePolynomial), _mm_andnot_ps(swap, sinePolynomial)), sineSign);
+    cosine = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, sinePolynomial), _mm_andnot_ps(swap, cosinePolynomial)), cosineSign);
+}
+
+//Stores 4 floats with a regular or a non-temporal store
+template <bool stream>
+inline void storeSse(float* out, __m128 value)
+{
+    if (stream)
+        _mm_stream_ps(out, value);
+    else
+        _mm_storeu_ps(out, value);
+}
+
+//4 instances from the arrays at input[0..6]: position x, y, z, axis x, y, z and angle
+template <bool stream>
+inline void computeTransformBatchSse(const float* const* input, std::size_t i, float* out, TransformLayout layout)
+{
+    auto x = _mm_loadu_ps(input[3] + i), y = _mm_loadu_ps(input[4] + i), z = _mm_loadu_ps(input[5] + i);
+    __m128 sine, cosine;
+    sinCosSse(_mm_loadu_ps(input[6] + i), sine, cosine);
+    auto t = _mm_sub_ps(_mm_set1_ps(1.0f), cosine);
+    auto tx = _mm_mul_ps(t, x), ty = _mm_mul_ps(t, y), tz = _mm_mul_ps(t, z);
+    auto sx = _mm_mul_ps(sine, x), sy = _mm_mul_ps(sine, y), sz = _mm_mul_ps(sine, z);
+    auto txy = _mm_mul_ps(tx, y), txz = _mm_mul_ps(tx, z), tyz = _mm_mul_ps(ty, z);
+    //mCR is column C, row R of the 4 model matrices
+    auto m00 = _mm_add_ps(cosine, _mm_mul_ps(tx, x)), m01 = _mm_add_ps(txy, sz), m02 = _mm_sub_ps(txz, sy);
+    auto m10 = _mm_sub_ps(txy, sz), m11 = _mm_add_ps(cosine, _mm_mul_ps(ty, y)), m12 = _mm_add_ps(tyz, sx);
+    auto m20 = _mm_add_ps(txz, sy), m21 = _mm_sub_ps(tyz, sx), m22 = _mm_add_ps(cosine, _mm_mul_ps(tz, z));
+    auto m30 = _mm_loadu_ps(input[0] + i), m31 = _mm_loadu_ps(input[1] + i), m32 = _mm_loadu_ps(input[2] + i);
+    //Transposed, a vector holds a column or row of one instance. The stores go instance by
+    //instance, so non-temporal ones fill whole cache lines in order.
+    if (layout == TransformLayout::Mat4)
+    {
+        auto zero = _mm_setzero_ps();
+        __m128 columns[4][4] = {{m00, m01, m02, zero}, {m10, m11, m12, zero}, {m20, m21, m22, zero}, {m30, m31, m32, _mm_set1_ps(1.0f)}};
+        for (auto& column : columns)
+            _MM_TRANSPOSE4_PS(column[0], column[1], column[2], column[3]);
+        for (int instance = 0; instance < 4; ++instance)
+        {
+            for (int column = 0; column < 4; ++column)
+                storeSse<stream>(out + instance * 16 + column * 4, columns[column][instance]);
+        }
+    }
+    else
+    {
+        __m128 rows[3][4] = {{m00, m10, m20, m30}, {m01, m11, m21, m31}, {m02, m12, m22, m32}};
+        for (auto& row : rows)
+            _MM_TRANSPOSE4_PS(row[0], row[1], row[2], row[3]);
+        for (int instance = 0; instance < 4; ++instance)
+        {
+            for (int row = 0; row < 3; ++row)
+                storeSse<stream>(out + instance * 12 + row * 4, rows[row][instance]);
+        }
+    }
+}
+
+template <bool stream>
+inline void computeTransformsSse(const float* const* input, std::size_t begin, std::size_t end, float* out, TransformLayout layout)
+{
+    std::size_t stride = layout == TransformLayout::Mat4 ? 16 : 12;
+    for (auto i = begin; i < end; i += 4, out += 4 * stride)
+        computeTransformBatchSse<stream>(input, i, out, layout);
+}
+#endif
+
+#if defined(TRANSFORM_BATCH_AVX2)
+TRANSFORM_BATCH_AVX2_TARGET inline void sinCosAvx2(__m256 angle, __m256& sine, __m256& cosine)
+{
+    auto quadrant = _mm256_cvtps_epi32(_mm256_mul_ps(angle, _mm256_set1_ps(sinCosTwoOverPi)));
+    auto multiple = _mm256_cvtepi32_ps(quadrant);
+    auto x = _mm256_fnmadd_ps(multiple, _mm256_set1_ps(sinCosHalfPi1), angle);
+    x = _mm256_fnmadd_ps(multiple, _mm256_set1_ps(sinCosHalfPi2), x);
+    x = _mm256_fnmadd_ps(multiple, _mm256_set1_ps(sinCosHalfPi3), x);
+    auto x2 = _mm256_mul_ps(x, x);
+
+    auto sinePolynomial = _mm256_fmadd_ps(_mm256_set1_ps(sinCosSine3), x2, _mm256_set1_ps(sinCosSine2));
+    sinePolynomial = _mm256_fmadd_ps(sinePolynomial, x2, _mm256_set1_ps(sinCosSine1));
+    sinePolynomial = _mm256_fmadd_ps(_mm256_mul_ps(sinePolynomial, x2), x, x);
+    auto cosinePolynomial = _mm256_fmadd_ps(_mm256_set1_ps(sinCosCosine3), x2, _mm256_set1_ps(sinCosCosine2));
+    cosinePolynomial = _mm256_fmadd_ps(cosinePolynomial, x2, _mm256_set1_ps(sinCosCosine1));
+    cosinePolynomial = _mm256_fmadd_ps(_mm256_mul_ps(cosinePolynomial, x2), x2,
+        _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), x2, _mm256_set1_ps(1.0f)));
+
+    auto swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+    auto sineSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(2)), 30));
+    auto cosineSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(quadrant, _mm256_set1_epi32(1)),
+        _mm256_set1_epi32(2)), 30));
+    sine = _mm256_xor_ps(_mm256_blendv_ps(sinePolynomial, cosinePolynomial, swap), sineSign);
+    cosine = _mm256_xor_ps(_mm256_blendv_ps(cosinePolynomial, sinePolynomial, swap), cosineSign);
+}
+
+//A 4x4 transpose in each 128-bit half: afterwards the low half of v[k] holds element k of
+//instances 0..3 and the high half the same of instances 4..7
+TRANSFORM_BATCH_AVX2_TARGET inline void transposeHalvesAvx2(__m256* v)
+{
+    auto t0 = _mm256_unpacklo_ps(v[0], v[1]), t1 = _mm256_unpackhi_ps(v[0], v[1]);
+    auto t2 = _mm256_unpacklo_ps(v[2], v[3]), t3 = _mm256_unpackhi_ps(v[2], v[3]);
+    v[0] = _mm256_shuffle_ps(t0, t2, 0x44);
+    v[1] = _mm256_shuffle_ps(t0, t2, 0xEE);
+    v[2] = _mm256_shuffle_ps(t1, t3, 0x44);
+    v[3] = _mm256_shuffle_ps(t1, t3, 0xEE);
+}
+
+//Instances 0..3 or 4..7 of the transposed columns or rows, instance by instance
+template <bool stream, int half>
+TRANSFORM_BATCH_AVX2_TARGET inline void storeHalfAvx2(__m256 (&columns)[4][4], float* out)
+{
+    //Columns 0 and 1, then 2 and 3 of an instance are 32 contiguous bytes
+    for (int instance = 0; instance < 4; ++instance)
+    {
+        auto target = out + (half * 4 + instance) * 16;
+        if (stream)
+        {
+            _mm256_stream_ps(target, _mm256_permute2f128_ps(columns[0][instance], columns[1][instance], half == 0 ? 0x20 : 0x31));
+            _mm256_stream_ps(target + 8, _mm256_permute2f128_ps(columns[2][instance], columns[3][instance], half == 0 ? 0x20 : 0x31));
+        }
+        else
+        {
+            _mm256_storeu_ps(target, _mm256_permute2f128_ps(columns[0][instance], columns[1][instance], half == 0 ? 0x20 : 0x31));
+            _mm256_storeu_ps(target + 8, _mm256_permute2f128_ps(columns[2][instance], columns[3][instance], half == 0 ? 0x20 : 0x31));
+        }
+    }
+}
+
+//The rows are 48 bytes apart, so they're stored 16 bytes at a time
+template <bool stream, int half>
+TRANSFORM_BATCH_AVX2_TARGET inline void storeHalfAvx2(__m256 (&rows)[3][4], float* out)
+{
+    for (int instance = 0; instance < 4; ++instance)
+    {
+        for (int row = 0; row < 3; ++row)
+            storeSse<stream>(out + (half * 4 + instance) * 12 + row * 4, _mm256_extractf128_ps(rows[row][instance], half));
+    }
+}
+
+//8 instances, like computeTransformBatchSse
+template <bool stream>
+TRANSFORM_BATCH_AVX2_TARGET inline void computeTransformBatchAvx2(const float* const* input, std::size_t i, float* out, TransformLayout layout)
+{
+    auto x = _mm256_loadu_ps(input[3] + i), y = _mm256_loadu_ps(input[4] + i), z = _mm256_loadu_ps(input[5] + i);
+    __m256 sine, cosine;
+    sinCosAvx2(_mm256_loadu_ps(input[6] + i), sine, cosine);
+    auto t = _mm256_sub_ps(_mm256_set1_ps(1.0f), cosine);
+    auto tx = _mm256_mul_ps(t, x), ty = _mm256_mul_ps(t, y), tz = _mm256_mul_ps(t, z);
+    auto sx = _mm256_mul_ps(sine, x), sy = _mm256_mul_ps(sine, y), sz = _mm256_mul_ps(sine, z);
+    auto txy = _mm256_mul_ps(tx, y), txz = _mm256_mul_ps(tx, z), tyz = _mm256_mul_ps(ty, z);
+    auto m00 = _mm256_fmadd_ps(tx, x, cosine), m01 = _mm256_add_ps(txy, sz), m02 = _mm256_sub_ps(txz, sy);
+    auto m10 = _mm256_sub_ps(txy, sz), m11 = _mm256_fmadd_ps(ty, y, cosine), m12 = _mm256_add_ps(tyz, sx);
+    auto m20 = _mm256_add_ps(txz, sy), m21 = _mm256_sub_ps(tyz, sx), m22 = _mm256_fmadd_ps(tz, z, cosine);
+    auto m30 = _mm256_loadu_ps(input[0] + i), m31 = _mm256_loadu_ps(input[1] + i), m32 = _mm256_loadu_ps(input[2] + i);
+    if (layout == TransformLayout::Mat4)
+    {
+        auto zero = _mm256_setzero_ps();
+        __m256 columns[4][4] = {{m00, m01, m02, zero}, {m10, m11, m12, zero}, {m20, m21, m22, zero},
+            {m30, m31, m32, _mm256_set1_ps(1.0f)}};
+        for (auto& column : columns)
+            transposeHalvesAvx2(column);
+        storeHalfAvx2<stream, 0>(columns, out);
+        storeHalfAvx2<stream, 1>(columns, out);
+    }
+    else
+    {
+        __m256 rows[3][4] = {{m00, m10, m20, m30}, {m01, m11, m21, m31}, {m02, m12, m22, m32}};
+        for (auto& row : rows)
+            transposeHalvesAvx2(row);
+        storeHalfAvx2<stream, 0>(rows, out);
+        storeHalfAvx2<stream, 1>(rows, out);
+    }
+}
+
+template <bool stream>
+TRANSFORM_BATCH_AVX2_TARGET inline void computeTransformsAvx2(const float* const* input, std::size_t begin, std::size_t end, float* out,
+    TransformLayout layout)
+{
+    std::size_t stride = layout == TransformLayout::Mat4 ? 16 : 12;
+    for (auto i = begin; i < end; i += 8, out += 8 * stride)
+        computeTransformBatchAvx2<stream>(input, i, out, layout);
+}
+#endif
+
+//Outputs at least this large are written with non-temporal stores, which skip the cache: they
+//wouldn't stay in it anyway, and the CPU doesn't read the old lines before writing them. They
+//need 16-byte alignment, and 32 for mat4 with AVX2, which mapped buffers always have.
+const std::size_t transformStreamingBytes = 4 << 20;
+
+//Whole batches read straight from the arrays. The last, partial one is copied to a padded
+//batch and back, so every instance goes through the same code.
+inline void computeTransformsSimd(const TransformBatch& batch, std::size_t begin, std::size_t end, float* out, TransformLayout layout,
+    TransformKernel kernel)
+{
+    const std::size_t batchSize = kernel == TransformKernel::Avx2 ? 8 : 4;
+    std::size_t stride = layout == TransformLayout::Mat4 ? 16 : 12;
+    const float* input[7] = {batch.getPositionX(), batch.getPositionY(), batch.getPositionZ(), batch.getAxisX(),
+        batch.getAxisY(), batch.getAxisZ(), batch.getAngles()};
+    auto wholeEnd = begin + (end - begin) / batchSize * batchSize;
+    std::size_t alignment = kernel == TransformKernel::Avx2 && layout == TransformLayout::Mat4 ? 32 : 16;
+    bool stream = (end - begin) * stride * sizeof(float) >= transformStreamingBytes && reinterpret_cast<std::uintptr_t>(out) % alignment == 0;
+#if defined(TRANSFORM_BATCH_AVX2)
+    if (kernel == TransformKernel::Avx2)
+    {
+        if (stream)
+            computeTransformsAvx2<true>(input, begin, wholeEnd, out, layout);
+        else
+            computeTransformsAvx2<false>(input, begin, wholeEnd, out, layout);
+    }
+#endif
+#if defined(TRANSFORM_BATCH_SSE)
+    if (kernel == TransformKernel::Sse)
+    {
+        if (stream)
+            computeTransformsSse<true>(input, begin, wholeEnd, out, layout);
+        else
+            computeTransformsSse<false>(input, begin, wholeEnd, out, layout);
+    }
+    //Non-temporal stores aren't ordered with the others
+    if (stream)
+        _mm_sfence();
+#endif
+    if (wholeEnd == end)
+        return;
+
+    float padded[7][8];
+    const float* paddedInput[7];
+    for (int array = 0; array < 7; ++array)
+    {
+        std::fill(padded[array], padded[array] + 8, array == 3 ? 1.0f : 0.0f);
+        std::copy(input[array] + wholeEnd, input[array] + end, padded[array]);
+        paddedInput[array] = padded[array];
+    }
+    float paddedOut[8 * 16];
+#if defined(TRANSFORM_BATCH_AVX2)
+    if (kernel == TransformKernel::Avx2)
+        computeTransformsAvx2<false>(paddedInput, 0, 8, paddedOut, layout);
+#endif
+#if defined(TRANSFORM_BATCH_SSE)
+    if (kernel == TransformKernel::Sse)
+        computeTransformsSse<false>(paddedInput, 0, 4, paddedOut, layout);
+#endif
+    std::copy(paddedOut, paddedOut + (end - wholeEnd) * stride, out + (wholeEnd - begin) * stride);
+}
+
+//Writes the model matrices of the instances in [begin, end) to out, which must have room for
+//(end - begin) * 16 or 12 floats. The kernel must be supported, getTransformKernel() picks the
+//best one. The SIMD kernels compute the sine and cosine with a polynomial, so they may differ
+//from glm::rotate in the last bits.
+inline void computeTransforms(const TransformBatch& batch, std::size_t begin, std::size_t end, float* out,
+    TransformLayout layout = TransformLayout::Mat4, TransformKernel kernel = getTransformKernel())
+{
+    if (kernel == TransformKernel::Scalar)
+        computeTransformsScalar(batch, begin, end, out, layout);
+    else
+        computeTransformsSimd(batch, begin, end, out, layout, kernel);
+}
+
+inline void TransformBatch::compute(glm::mat4* models) const
+{
+    computeTransforms(*this, 0, size(), glm::value_ptr(models[0]));
+}
+
+#endif
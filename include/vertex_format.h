@@ -0,0 +1,180 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <opengl_loader.h>
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+//One attribute of a vertex layout, i.e. the arguments of glVertexAttribPointer
+struct VertexAttribute
+{
+    GLuint location;
+    GLint size;
+    GLenum type;
+    bool normalized;
+    std::size_t offset;
+};
+
+//A vertex layout which can set itself up on the bound VAO and vertex buffer
+struct VertexFormat
+{
+    std::size_t stride;
+    std::vector<VertexAttribute> attributes;
+
+    void apply() const
+    {
+        for (const auto& attribute : attributes)
+        {
+            glVertexAttribPointer(attribute.location, attribute.size, attribute.type, attribute.normalized,
+                static_cast<GLsizei>(stride), reinterpret_cast<void*>(attribute.offset));
+            glEnableVertexAttribArray(attribute.location);
+        }
+    }
+};
+
+//The vertex of the chapters' setupVAO, 32 bytes
+struct FloatVertex
+{
+    GLfloat position[3];
+    GLfloat color[3];
+    GLfloat texture[2];
+};
+
+//16 bytes: positions as 16-bit normalized integers relative to the bounding box of the mesh,
+//color as RGBA8 and texture coordinates as half floats. position[3] is padding, so the color
+//starts on a 4 byte boundary.
+struct CompactVertex
+{
+    std::int16_t position[4];
+    std::uint8_t color[4];
+    std::uint16_t texture[2];
+};
+
+static_assert(sizeof(CompactVertex) == 16, "CompactVertex must be 16 bytes");
+
+//The result of compactVertices(). The vertex shader gets the position back with
+//
+//    uniform vec3 positionScale;
+//    uniform vec3 positionOffset;
+//    vec3 position = aPos * positionScale + positionOffset;
+//
+//since the normalized attribute is in [-1, 1].
+struct CompactMesh
+{
+    std::vector<CompactVertex> vertices;
+    GLfloat positionScale[3];
+    GLfloat positionOffset[3];
+};
+
+//Round to nearest even, with denormals, infinity and NaN
+inline std::uint16_t floatToHalf(float value)
+{
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    std::uint32_t sign = (bits >> 16) & 0x8000;
+    std::uint32_t exponent = (bits >> 23) & 0xFF;
+    std::uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (exponent == 0xFF)
+        return static_cast<std::uint16_t>(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));
+    int halfExponent = static_cast<int>(exponent) - 127 + 15;
+    if (halfExponent >= 31)
+        return static_cast<std::uint16_t>(sign | 0x7C00);
+    if (halfExponent <= 0)
+    {
+        //Denormal or zero. Shift in the implicit bit and round.
+        if (halfExponent < -10)
+            return static_cast<std::uint16_t>(sign);
+        mantissa |= 0x800000;
+        int shift = 14 - halfExponent;
+        std::uint32_t half = mantissa >> shift;
+        std::uint32_t remainder = mantissa & ((1u << shift) - 1);
+        std::uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1)))
+            ++half;
+        return static_cast<std::uint16_t>(sign | half);
+    }
+    std::uint32_t half = (static_cast<std::uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+    std::uint32_t remainder = mantissa & 0x1FFF;
+    //A carry into the exponent is the correct rounding, up to infinity
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+        ++half;
+    return static_cast<std::uint16_t>(sign | half);
+}
+
+inline std::uint8_t toUnorm8(float value)
+{
+    value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+    return static_cast<std::uint8_t>(std::lround(value * 255.0f));
+}
+
+inline std::int16_t toSnorm16(float value)
+{
+    value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+    return static_cast<std::int16_t>(std::lround(value * 32767.0f));
+}
+
+//Converts the vertices to CompactVertex. The positions are quantized in the bounding box of the
+//mesh, so the error is at most half of its size / 65534 on each axis.
+inline CompactMesh compactVertices(const FloatVertex* vertices, std::size_t vertexCount)
+{
+    CompactMesh mesh;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float minimum = vertexCount > 0 ? vertices[0].position[axis] : 0.0f;
+        float maximum = minimum;
+        for (std::size_t i = 1; i < vertexCount; ++i)
+        {
+            minimum = std::fmin(minimum, vertices[i].position[axis]);
+            maximum = std::fmax(maximum, vertices[i].position[axis]);
+        }
+        mesh.positionOffset[axis] = (minimum + maximum) * 0.5f;
+        //A flat axis still needs a scale we can divide by
+        mesh.positionScale[axis] = maximum > minimum ? (maximum - minimum) * 0.5f : 1.0f;
+    }
+
+    mesh.vertices.resize(vertexCount);
+    for (std::size_t i = 0; i < vertexCount; ++i)
+    {
+        const auto& source = vertices[i];
+        auto& target = mesh.vertices[i];
+        for (int axis = 0; axis < 3; ++axis)
+            target.position[axis] = toSnorm16((source.position[axis] - mesh.positionOffset[axis]) / mesh.positionScale[axis]);
+        target.position[3] = 0;
+        for (int channel = 0; channel < 3; ++channel)
+            target.color[channel] = toUnorm8(source.color[channel]);
+        target.color[3] = 255;
+        target.texture[0] = floatToHalf(source.texture[0]);
+        target.texture[1] = floatToHalf(source.texture[1]);
+    }
+    return mesh;
+}
+
+//Locations 0, 1 and 2 like in the chapters' shaders
+inline VertexFormat getFloatVertexFormat()
+{
+    VertexFormat format;
+    format.stride = sizeof(FloatVertex);
+    format.attributes.push_back({0, 3, GL_FLOAT, false, offsetof(FloatVertex, position)});
+    format.attributes.push_back({1, 3, GL_FLOAT, false, offsetof(FloatVertex, color)});
+    format.attributes.push_back({2, 2, GL_FLOAT, false, offsetof(FloatVertex, texture)});
+    return format;
+}
+
+//The shaders read the same vec3 aPos, vec3 aColor and vec2 aTexCoord, the conversion happens
+//in the vertex fetch. Only the position needs positionScale and positionOffset.
+inline VertexFormat getCompactVertexFormat()
+{
+    VertexFormat format;
+    format.stride = sizeof(CompactVertex);
+    format.attributes.push_back({0, 3, GL_SHORT, true, offsetof(CompactVertex, position)});
+    format.attributes.push_back({1, 4, GL_UNSIGNED_BYTE, true, offsetof(CompactVertex, color)});
+    format.attributes.push_back({2, 2, GL_HALF_FLOAT, false, offsetof(CompactVertex, texture)});
+    return format;
+}
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef VERTEX_WELD_H
+#define VERTEX_WELD_H
+
+#include <opengl_loader.h>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+inline std::uint32_t rotateLeft(std::uint32_t value, int shift)
+{
+    return (value << shift) | (value >> (32 - shift));
+}
+
+//MurmurHash3 (x86, 32-bit) of the bytes of a vertex. It reads 4 bytes at a time, which is much
+//faster than FNV-1a for tens of millions of vertices, and mixes well enough for float data.
+inline std::uint32_t hashVertex(const unsigned char* data, std::size_t size)
+{
+    const std::uint32_t c1 = 0xCC9E2D51;
+    const std::uint32_t c2 = 0x1B873593;
+    auto hash = static_cast<std::uint32_t>(size);
+    std::size_t i = 0;
+    for (; i + 4 <= size; i += 4)
+    {
+        std::uint32_t word;
+        std::memcpy(&word, data + i, 4);
+        word = rotateLeft(word * c1, 15) * c2;
+        hash = rotateLeft(hash ^ word, 13) * 5 + 0xE6546B64;
+    }
+    std::uint32_t tail = 0;
+    for (std::size_t shift = 0; i < size; ++i, shift += 8)
+        tail |= static_cast<std::uint32_t>(data[i]) << shift;
+    hash ^= rotateLeft(tail * c1, 15) * c2;
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6B;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+const std::uint32_t emptyWeldSlot = 0xFFFFFFFF;
+
+//A set of vertices of an array, where two vertices are the same if their bytes are the same.
+//It's open addressing with linear probing: the hashes and the slots are two flat arrays, so a
+//probe reads consecutive hashes and compares the vertex bytes only when the 32-bit hash
+//matches. It grows by doubling and keeps the load under 1/2, so an insertion is amortized
+//constant time and the table uses at most 32 bytes per unique vertex.
+class VertexWeldTable
+{
+public:
+    VertexWeldTable(const void* vertices, std::size_t stride, std::size_t expectedSize = 0) :
+        vertices{static_cast<const unsigned char*>(vertices)},
+        stride{stride},
+        size{0}
+    {
+        std::size_t capacity = 16;
+        while (capacity < expectedSize * 2)
+            capacity *= 2;
+        hashes.resize(capacity);
+        slots.assign(capacity, emptyWeldSlot);
+    }
+
+    //Returns the index of the first inserted vertex with the same bytes as vertex, which is
+    //vertex itself if it's new
+    std::uint32_t insert(std::uint32_t vertex)
+    {
+        if ((size + 1) * 2 > slots.size())
+            grow();
+        auto data = vertices + static_cast<std::size_t>(vertex) * stride;
+        auto hash = hashVertex(data, stride);
+        auto mask = slots.size() - 1;
+        for (auto i = hash & mask;; i = (i + 1) & mask)
+        {
+            if (slots[i] == emptyWeldSlot)
+            {
+                hashes[i] = hash;
+                slots[i] = vertex;
+                ++size;
+                return vertex;
+            }
+            if (hashes[i] == hash && std::memcmp(vertices + static_cast<std::size_t>(slots[i]) * stride, data, stride) == 0)
+                return slots[i];
+        }
+    }
+
+    std::size_t getSize() const
+    {
+        return size;
+    }
+
+private:
+    //The stored hashes are enough to move the slots, no vertex is read again
+    void grow()
+    {
+        std::vector<std::uint32_t> oldHashes, oldSlots;
+        oldHashes.swap(hashes);
+        oldSlots.swap(slots);
+        hashes.resize(oldSlots.size() * 2);
+        slots.assign(oldSlots.size() * 2, emptyWeldSlot);
+        auto mask = slots.size() - 1;
+        for (std::size_t j = 0; j < oldSlots.size(); ++j)
+        {
+            if (oldSlots[j] == emptyWeldSlot)
+                continue;
+            auto i = oldHashes[j] & mask;
+            while (slots[i] != emptyWeldSlot)
+                i = (i + 1) & mask;
+            hashes[i] = oldHashes[j];
+            slots[i] = oldSlots[j];
+        }
+    }
+
+    const unsigned char* vertices;
+    std::size_t stride;
+    std::size_t size;
+    std::vector<std::uint32_t> hashes;
+    std::vector<std::uint32_t> slots;
+};
+
+//Welds the bit-identical vertices of a triangle soup (or any vertex array) of count vertices.
+//indices gets one index per soup vertex, sources gets the position in the soup of each unique
+//vertex, in the order they first appear. Linear time and memory.
+inline void weldVertexBytes(const void* soup, std::size_t count, std::size_t stride, std::vector<GLuint>& indices,
+    std::vector<std::uint32_t>& sources)
+{
+    if (count >= emptyWeldSlot)
+        throw std::string("Cannot weld more than 2^32 - 1 vertices");
+
+    //Meshes usually have far fewer unique vertices than corners, e.g. a grid has 1/6 of them
+    VertexWeldTable table(soup, stride, count / 4);
+    indices.resize(count);
+    sources.clear();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto vertex = static_cast<std::uint32_t>(i);
+        auto first = table.insert(vertex);
+        if (first == vertex)
+        {
+            indices[i] = static_cast<GLuint>(sources.size());
+            sources.push_back(vertex);
+        }
+        else
+            indices[i] = indices[first];
+    }
+}
+
+//Turns a triangle soup into a minimal vertex buffer and an index buffer for
+//glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, ...), so the triangles can be
+//written corner by corner instead of sharing their vertices by hand. The whole Vertex is
+//compared: corners with the same position but another color or texture coordinate stay
+//separate. It must not have padding bytes, and -0.0f and 0.0f are different vertices.
+template <typename Vertex>
+void weldVertices(const Vertex* soup, std::size_t count, std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+{
+    std::vector<std::uint32_t> sources;
+    weldVertexBytes(soup, count, sizeof(Vertex), indices, sources);
+    vertices.resize(sources.size());
+    for (std::size_t i = 0; i < sources.size(); ++i)
+        vertices[i] = soup[sources[i]];
+}
+
+#endif